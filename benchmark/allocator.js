@@ -0,0 +1,65 @@
+var sqlite3 = require('../lib/sqlite3');
+var fork = require('child_process').fork;
+
+// SQLite can only be configured before the first database is opened, so
+// every case runs the workload in a process of its own.
+var iterations = 20000;
+var connections = 4;
+
+function workload(finished) {
+    var remaining = connections;
+    for (var c = 0; c < connections; c++) {
+        var db = new sqlite3.Database('');
+        db.serialize(function() {
+            db.run("CREATE TABLE foo (id INT, txt TEXT)");
+            var stmt = db.prepare("INSERT INTO foo VALUES (?, ?)");
+            var sets = [];
+            for (var i = 0; i < iterations; i++) {
+                sets.push([i, 'Row ' + i]);
+            }
+            stmt.runBatch(sets, { transaction: true, aggregate: true });
+            stmt.finalize();
+            db.all("SELECT txt, COUNT(*) FROM foo GROUP BY id % 1000 ORDER BY txt");
+        });
+        db.close(function(err) {
+            if (err) throw err;
+            if (!--remaining) finished();
+        });
+    }
+}
+
+function run(options, finished) {
+    var child = fork(__filename, [ JSON.stringify(options) ]);
+    child.on('exit', function(code) {
+        if (code) throw new Error('Benchmark process failed with ' + code);
+        finished();
+    });
+}
+
+if (process.argv[2]) {
+    sqlite3.configure(JSON.parse(process.argv[2]));
+    workload(function() {
+        process.exit(0);
+    });
+}
+else {
+    exports.compare = {
+        'system allocator': function(finished) {
+            run({}, finished);
+        },
+        'system allocator without memstatus': function(finished) {
+            run({ memstatus: false }, finished);
+        },
+        'pool allocator without memstatus': function(finished) {
+            run({ allocator: 'pool', memstatus: false }, finished);
+        },
+        'pool allocator with a page cache and lookaside': function(finished) {
+            run({
+                allocator: 'pool',
+                memstatus: false,
+                pageCache: { pageSize: 1024, pages: 4096 },
+                lookaside: { size: 256, count: 500 }
+            }, finished);
+        }
+    };
+}
@@ -51,6 +51,40 @@ exports.compare = {
 
         db.close(finished);
     },
+    'insert with runBatch': function(finished) {
+        var db = new sqlite3.Database('');
+
+        db.serialize(function() {
+            db.run("CREATE TABLE foo (id INT, txt TEXT)");
+            var stmt = db.prepare("INSERT INTO foo VALUES (?, ?)");
+            var sets = [];
+            for (var i = 0; i < iterations; i++) {
+                sets.push([i, 'Row ' + i]);
+            }
+            stmt.runBatch(sets, { transaction: true, aggregate: true });
+            stmt.finalize();
+        });
+
+        db.close(finished);
+    },
+    'insert with runColumns': function(finished) {
+        var db = new sqlite3.Database('');
+
+        db.serialize(function() {
+            db.run("CREATE TABLE foo (id INT, txt TEXT)");
+            var stmt = db.prepare("INSERT INTO foo VALUES (?, ?)");
+            var ids = new Int32Array(iterations);
+            var texts = [];
+            for (var i = 0; i < iterations; i++) {
+                ids[i] = i;
+                texts.push('Row ' + i);
+            }
+            stmt.runColumns([ ids, texts ]);
+            stmt.finalize();
+        });
+
+        db.close(finished);
+    },
     'insert without transaction': function(finished) {
         var db = new sqlite3.Database('');
 
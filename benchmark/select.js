@@ -0,0 +1,66 @@
+var sqlite3 = require('../lib/sqlite3');
+var fs = require('fs');
+
+var filename = 'benchmark/select.db';
+var rows = 200000;
+var iterations = 50000;
+
+var created = false;
+function createdb(callback) {
+    if (created) return callback();
+    if (fs.existsSync(filename)) fs.unlinkSync(filename);
+
+    var db = new sqlite3.Database(filename);
+    db.serialize(function() {
+        db.run("CREATE TABLE foo (id INTEGER PRIMARY KEY, txt TEXT)");
+        var stmt = db.prepare("INSERT INTO foo VALUES (?, ?)");
+        var sets = [];
+        var padding = new Array(200).join('x');
+        for (var i = 0; i < rows; i++) {
+            sets.push([i, 'Row ' + i + padding]);
+        }
+        stmt.runBatch(sets, { transaction: true, aggregate: true });
+        stmt.finalize();
+    });
+    db.close(function(err) {
+        if (err) throw err;
+        created = true;
+        callback();
+    });
+}
+
+// Random point lookups, the access pattern of a read-only reference
+// database that is much larger than the page cache.
+function lookup(options, finished) {
+    createdb(function() {
+        var db = new sqlite3.Database(filename, options);
+        var stmt = db.prepare("SELECT txt FROM foo WHERE id = ?");
+        var remaining = iterations;
+        for (var i = 0; i < iterations; i++) {
+            stmt.get(Math.floor(Math.random() * rows), function(err, row) {
+                if (err) throw err;
+                if (--remaining) return;
+                stmt.finalize();
+                db.close(finished);
+            });
+        }
+    });
+}
+
+exports.compare = {
+    'select with default options': function(finished) {
+        lookup({}, finished);
+    },
+    'select with a small page cache': function(finished) {
+        lookup({ cacheSize: 100 }, finished);
+    },
+    'select with a small page cache and a memory mapping': function(finished) {
+        lookup({ cacheSize: 100, mmapSize: 1 << 30 }, finished);
+    },
+    'select from an immutable database with a memory mapping': function(finished) {
+        lookup({ mmapSize: 1 << 30, immutable: true }, finished);
+    },
+    'select from an immutable database with readers': function(finished) {
+        lookup({ mmapSize: 1 << 30, immutable: true, readers: 4 }, finished);
+    }
+};
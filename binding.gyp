@@ -23,9 +23,15 @@
         ]
       ],
       'sources': [
+        'src/allocator.cc',
+        'src/blob.cc',
+        'src/checkpoint.cc',
         'src/database.cc',
+        'src/function.cc',
         'src/node_sqlite3.cc',
-        'src/statement.cc'
+        'src/statement.cc',
+        'src/stats.cc',
+        'src/worker.cc'
       ],
     }
   ]
@@ -85,6 +85,12 @@
         'SQLITE_ENABLE_FTS3',
         'SQLITE_ENABLE_RTREE'
       ],
+      'conditions': [
+        ['target_arch == "x64"', {
+          # SQLite maps at most 2GB of a database by default.
+          'defines': [ 'SQLITE_MAX_MMAP_SIZE=0x1000000000' ],
+        }]
+      ],
       'export_dependent_settings': [
         'action_before_build',
       ]
@@ -10,6 +10,10 @@ var sqlite3 = module.exports = exports = binding;
 var path = require('path');
 var util = require('util');
 var EventEmitter = require('events').EventEmitter;
+var streams = require('./stream');
+var RowStream = streams.RowStream;
+var BlobReadStream = streams.BlobReadStream;
+var BlobWriteStream = streams.BlobWriteStream;
 
 function errorCallback(args) {
     if (typeof args[args.length - 1] === 'function') {
@@ -24,10 +28,10 @@ function inherits(target, source) {
 }
 
 sqlite3.cached = {
-    Database: function(file, a, b) {
+    Database: function(file, a, b, c) {
         if (file === '' || file === ':memory:') {
             // Don't cache special databases.
-            return new Database(file, a, b);
+            return new Database(file, a, b, c);
         }
 
         if (file[0] !== '/') {
@@ -35,12 +39,14 @@ sqlite3.cached = {
         }
 
         if (!sqlite3.cached.objects[file]) {
-            var db =sqlite3.cached.objects[file] = new Database(file, a, b);
+            var db =sqlite3.cached.objects[file] = new Database(file, a, b, c);
         }
         else {
             // Make sure the callback is called.
             var db = sqlite3.cached.objects[file];
-            var callback = (typeof a === 'number') ? b : a;
+            var callback = [a, b, c].filter(function(arg) {
+                return typeof arg === 'function';
+            })[0];
             if (typeof callback === 'function') {
                 function cb() { callback.call(db, null); }
                 if (db.open) process.nextTick(cb);
@@ -56,9 +62,11 @@ sqlite3.cached = {
 
 var Database = sqlite3.Database;
 var Statement = sqlite3.Statement;
+var Blob = sqlite3.Blob;
 
 inherits(Database, EventEmitter);
 inherits(Statement, EventEmitter);
+inherits(Blob, EventEmitter);
 
 // Database#prepare(sql, [bind1, bind2, ...], [callback])
 Database.prototype.prepare = function(sql) {
@@ -76,7 +84,7 @@ Database.prototype.prepare = function(sql) {
 // Database#run(sql, [bind1, bind2, ...], [callback])
 Database.prototype.run = function(sql) {
     var params = Array.prototype.slice.call(arguments, 1);
-    var statement = new Statement(this, sql, errorCallback(params));
+    var statement = new Statement(this, sql, errorCallback(params), { cache: true });
     statement.run.apply(statement, params).finalize();
     return this;
 };
@@ -84,7 +92,7 @@ Database.prototype.run = function(sql) {
 // Database#get(sql, [bind1, bind2, ...], [callback])
 Database.prototype.get = function(sql) {
     var params = Array.prototype.slice.call(arguments, 1);
-    var statement = new Statement(this, sql, errorCallback(params));
+    var statement = new Statement(this, sql, errorCallback(params), { cache: true });
     statement.get.apply(statement, params).finalize();
     return this;
 };
@@ -92,7 +100,7 @@ Database.prototype.get = function(sql) {
 // Database#all(sql, [bind1, bind2, ...], [callback])
 Database.prototype.all = function(sql) {
     var params = Array.prototype.slice.call(arguments, 1);
-    var statement = new Statement(this, sql, errorCallback(params));
+    var statement = new Statement(this, sql, errorCallback(params), { cache: true });
     statement.all.apply(statement, params).finalize();
     return this;
 };
@@ -100,14 +108,102 @@ Database.prototype.all = function(sql) {
 // Database#each(sql, [bind1, bind2, ...], [callback], [complete])
 Database.prototype.each = function(sql) {
     var params = Array.prototype.slice.call(arguments, 1);
-    var statement = new Statement(this, sql, errorCallback(params));
+    var statement = new Statement(this, sql, errorCallback(params), { cache: true });
     statement.each.apply(statement, params).finalize();
     return this;
 };
 
+// Database#backup(filename, [options], [callback])
+// Returns an emitter of 'progress' events with the remaining and total
+// page counts.
+var backup = Database.prototype.backup;
+Database.prototype.backup = function(filename, options, callback) {
+    if (typeof options === 'function') {
+        callback = options;
+        options = undefined;
+    }
+    options = options || {};
+
+    var emitter = new EventEmitter();
+    backup.call(this, filename,
+        options.pagesPerStep === undefined ? 100 : options.pagesPerStep,
+        options.sleepMs === undefined ? 10 : options.sleepMs,
+        function(remaining, total) {
+            emitter.emit('progress', { remaining: remaining, total: total });
+        },
+        function(err) {
+            if (callback) callback.call(this, err);
+            else if (err) emitter.emit('error', err);
+            emitter.emit('finish');
+        });
+    return emitter;
+};
+
+// Database#registerFunction(name, [options], fn, [callback])
+// Scalar functions are called with the SQL arguments. Aggregates are called
+// once per group with an array of the argument lists of all its rows.
+// Every scalar call is a round trip to the main thread while the query
+// waits, since SQLite needs the result before it can step on; set
+// `deterministic` to reuse the results of recent arguments.
+var registerFunction = Database.prototype.registerFunction;
+Database.prototype.registerFunction = function(name, options, fn, callback) {
+    if (typeof options === 'function') {
+        callback = fn;
+        fn = options;
+        options = undefined;
+    }
+    return registerFunction.call(this, name, options || {}, fn, callback);
+};
+
+function runSync(method) {
+    return function(sql) {
+        var params = Array.prototype.slice.call(arguments, 1);
+        var statement = new Statement(this, sql, undefined, { sync: true });
+        try {
+            return statement[method].apply(statement, params);
+        } finally {
+            statement.finalize();
+        }
+    };
+}
+
+// Database#getSync(sql, [bind1, bind2, ...])
+Database.prototype.getSync = runSync('getSync');
+
+// Database#runSync(sql, [bind1, bind2, ...])
+Database.prototype.runSync = runSync('runSync');
+
+// Database#allSync(sql, [bind1, bind2, ...])
+Database.prototype.allSync = runSync('allSync');
+
+// Database#stream(sql, [bind1, bind2, ...])
+Database.prototype.stream = function(sql) {
+    var params = Array.prototype.slice.call(arguments, 1);
+    var stream;
+    var statement = new Statement(this, sql, function(err) {
+        if (err) stream._fail(err);
+    });
+    stream = new RowStream(statement, params, { owned: true });
+    return stream;
+};
+
+// Database#openBlob(table, column, rowid, [options])
+// Returns a readable stream over the value, or a writable stream when
+// `options.writable` is set.
+Database.prototype.openBlob = function(table, column, rowid, options) {
+    options = options || {};
+    var db = this;
+    function open(callback) {
+        return new Blob(db, table, column, rowid, !!options.writable, callback);
+    }
+    return options.writable ?
+        new BlobWriteStream(open, options) :
+        new BlobReadStream(open, options);
+};
+
 Database.prototype.map = function(sql) {
     var params = Array.prototype.slice.call(arguments, 1);
-    var statement = new Statement(this, sql, errorCallback(params));
+    var statement = new Statement(this, sql, errorCallback(params), { cache: true });
     statement.map.apply(statement, params).finalize();
     return this;
 };
@@ -138,6 +234,12 @@ Statement.prototype.map = function() {
     return this.all.apply(this, params);
 };
 
+// Statement#stream([bind1, bind2, ...])
+Statement.prototype.stream = function() {
+    var params = Array.prototype.slice.call(arguments);
+    return new RowStream(this, params);
+};
+
 var isVerbose = false;
 
 var supportedEvents = [ 'trace', 'profile', 'insert', 'update', 'delete' ];
@@ -178,11 +280,19 @@ sqlite3.verbose = function() {
         trace.extendTrace(Database.prototype, 'map');
         trace.extendTrace(Database.prototype, 'exec');
         trace.extendTrace(Database.prototype, 'close');
+        trace.extendTrace(Database.prototype, 'backup');
+        trace.extendTrace(Database.prototype, 'registerFunction');
+        trace.extendTrace(Blob.prototype, 'read');
+        trace.extendTrace(Blob.prototype, 'write');
+        trace.extendTrace(Blob.prototype, 'close');
         trace.extendTrace(Statement.prototype, 'bind');
         trace.extendTrace(Statement.prototype, 'get');
         trace.extendTrace(Statement.prototype, 'run');
+        trace.extendTrace(Statement.prototype, 'runBatch');
+        trace.extendTrace(Statement.prototype, 'runColumns');
         trace.extendTrace(Statement.prototype, 'all');
         trace.extendTrace(Statement.prototype, 'each');
+        trace.extendTrace(Statement.prototype, 'fetch');
         trace.extendTrace(Statement.prototype, 'map');
         trace.extendTrace(Statement.prototype, 'reset');
         trace.extendTrace(Statement.prototype, 'finalize');
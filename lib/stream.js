@@ -0,0 +1,219 @@
+var util = require('util');
+var Readable = require('stream').Readable;
+var Writable = require('stream').Writable;
+
+// Object mode stream that pulls rows from a statement with Statement#fetch.
+// Rows are only stepped when the consumer asks for more, so a slow consumer
+// holds back the query instead of buffering the whole result set.
+function RowStream(statement, params, options) {
+    if (!Readable) {
+        throw new Error('Row streams require Node 0.10 or newer');
+    }
+    options = options || {};
+    Readable.call(this, {
+        objectMode: true,
+        highWaterMark: options.highWaterMark || 64
+    });
+
+    this.statement = statement;
+    this.owned = !!options.owned;
+    this.fetching = false;
+    this.finished = false;
+
+    var stream = this;
+    function onError(err) { if (err) stream._fail(err); }
+    if (params.length) {
+        statement.bind.apply(statement, params.concat([ onError ]));
+    }
+    else {
+        statement.reset(onError);
+    }
+}
+
+if (Readable) util.inherits(RowStream, Readable);
+
+RowStream.prototype._read = function(size) {
+    if (this.fetching || this.finished) return;
+    this.fetching = true;
+
+    var stream = this;
+    this.statement.fetch(size, function(err, rows, done) {
+        stream.fetching = false;
+        if (stream.finished) return;
+        if (err) return stream._fail(err);
+
+        if (done) stream._finish();
+        for (var i = 0; i < rows.length; i++) {
+            stream.push(rows[i]);
+        }
+        if (done) stream.push(null);
+    });
+};
+
+RowStream.prototype._finish = function() {
+    this.finished = true;
+    if (this.owned) this.statement.finalize();
+};
+
+RowStream.prototype._fail = function(err) {
+    if (this.finished) return;
+    this._finish();
+    this.emit('error', err);
+};
+
+// Stops reading early. The statement is finalized if it was created by
+// Database#stream and is otherwise left to be reset by the next call.
+RowStream.prototype.close = function() {
+    if (this.finished) return;
+    this._finish();
+    this.push(null);
+};
+
+exports.RowStream = RowStream;
+
+
+// Byte stream over a single BLOB value. `open(callback)` creates the native
+// Blob handle; the value is read in chunks of `chunkSize` bytes starting at
+// `start`, and the handle is closed once the end is reached.
+function BlobReadStream(open, options) {
+    if (!Readable) {
+        throw new Error('Blob streams require Node 0.10 or newer');
+    }
+    options = options || {};
+    this.chunkSize = options.chunkSize || 65536;
+    Readable.call(this, { highWaterMark: this.chunkSize });
+
+    this.position = options.start || 0;
+    this.waiting = false;
+    this.finished = false;
+
+    var stream = this;
+    this.blob = open(function(err) {
+        if (err) return stream._fail(err);
+        stream.length = this.length;
+        stream.emit('open', this.length);
+        if (stream.waiting) stream._read();
+    });
+}
+
+if (Readable) util.inherits(BlobReadStream, Readable);
+
+BlobReadStream.prototype._read = function() {
+    if (this.finished) return;
+    if (this.length === undefined) {
+        this.waiting = true;
+        return;
+    }
+    this.waiting = false;
+
+    if (this.position >= this.length) {
+        this._finish();
+        return this.push(null);
+    }
+
+    var stream = this;
+    this.reading = true;
+    this.blob.read(this.position, this.chunkSize, function(err, buffer) {
+        stream.reading = false;
+        if (stream.finished) return stream._closeBlob();
+        if (err) return stream._fail(err);
+        stream.position += buffer.length;
+        stream.push(buffer);
+    });
+};
+
+BlobReadStream.prototype._finish = function() {
+    this.finished = true;
+    // A read in progress closes the blob once it is done.
+    if (this.length !== undefined && !this.reading) this._closeBlob();
+};
+
+BlobReadStream.prototype._closeBlob = function() {
+    var stream = this;
+    this.blob.close(function(err) {
+        if (err) stream.emit('error', err);
+        stream.emit('close');
+    });
+};
+
+BlobReadStream.prototype._fail = function(err) {
+    if (this.finished) return;
+    this._finish();
+    this.emit('error', err);
+};
+
+// Stops reading early and closes the blob handle.
+BlobReadStream.prototype.close = function() {
+    if (this.finished) return;
+    if (this.length === undefined) {
+        return this.once('open', this.close);
+    }
+    this._finish();
+    this.push(null);
+};
+
+exports.BlobReadStream = BlobReadStream;
+
+
+// Writes into an existing BLOB value starting at `start`. Incremental I/O
+// can't resize a value, so the row has to be created with a large enough
+// value first, e.g. with zeroblob(n). The handle is closed on 'finish' and
+// 'close' is emitted once that is done.
+function BlobWriteStream(open, options) {
+    if (!Writable) {
+        throw new Error('Blob streams require Node 0.10 or newer');
+    }
+    options = options || {};
+    Writable.call(this, { highWaterMark: options.highWaterMark || 65536 });
+
+    this.position = options.start || 0;
+    this.opened = false;
+    this.failed = false;
+
+    var stream = this;
+    this.blob = open(function(err) {
+        if (err) {
+            stream.failed = true;
+            return stream.emit('error', err);
+        }
+        stream.opened = true;
+        stream.length = this.length;
+        stream.emit('open', this.length);
+    });
+
+    this.once('finish', function() {
+        if (stream.opened) stream._close();
+        else if (!stream.failed) stream.once('open', stream._close);
+    });
+}
+
+if (Writable) util.inherits(BlobWriteStream, Writable);
+
+BlobWriteStream.prototype._write = function(chunk, encoding, callback) {
+    if (!this.opened) {
+        if (this.failed) return callback(new Error('Blob could not be opened'));
+        return this.once('open', function() {
+            this._write(chunk, encoding, callback);
+        });
+    }
+
+    var stream = this;
+    this.blob.write(this.position, chunk, function(err) {
+        if (err) {
+            stream._close();
+            return callback(err);
+        }
+        stream.position += chunk.length;
+        callback();
+    });
+};
+
+BlobWriteStream.prototype._close = function() {
+    var stream = this;
+    this.blob.close(function(err) {
+        if (err) stream.emit('error', err);
+        stream.emit('close');
+    });
+};
+
+exports.BlobWriteStream = BlobWriteStream;
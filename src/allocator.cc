@@ -0,0 +1,116 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "threading.h"
+
+using namespace node_sqlite3;
+
+namespace {
+
+const int class_sizes[] = {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096
+};
+const int class_count = sizeof(class_sizes) / sizeof(class_sizes[0]);
+
+// Precedes every block and keeps SQLite's 8-byte alignment.
+union Header {
+    sqlite3_int64 size;
+    double align;
+};
+
+// Size class of every multiple of 16 bytes up to max_cached; filled by
+// PoolAllocator::Init.
+unsigned char class_table[PoolAllocator::max_cached / 16 + 1];
+
+struct CachedBlock {
+    CachedBlock* next;
+};
+
+NODE_SQLITE3_THREAD_LOCAL CachedBlock* cache_heads[class_count];
+NODE_SQLITE3_THREAD_LOCAL unsigned int cache_counts[class_count];
+
+}
+
+const sqlite3_mem_methods PoolAllocator::methods = {
+    Malloc,
+    Free,
+    Realloc,
+    Size,
+    Roundup,
+    Init,
+    Shutdown,
+    NULL
+};
+
+int PoolAllocator::Class(int size) {
+    if (size > max_cached) return -1;
+    return class_table[(size + 15) / 16];
+}
+
+int PoolAllocator::Roundup(int size) {
+    int index = Class(size);
+    if (index >= 0) return class_sizes[index];
+    return (size + 7) & ~7;
+}
+
+void* PoolAllocator::Malloc(int size) {
+    size = Roundup(size);
+    int index = Class(size);
+
+    if (index >= 0 && cache_heads[index]) {
+        CachedBlock* block = cache_heads[index];
+        cache_heads[index] = block->next;
+        cache_counts[index]--;
+        return block;
+    }
+
+    Header* header = static_cast<Header*>(malloc(sizeof(Header) + size));
+    if (header == NULL) return NULL;
+    header->size = size;
+    return header + 1;
+}
+
+void PoolAllocator::Free(void* block) {
+    if (block == NULL) return;
+    Header* header = static_cast<Header*>(block) - 1;
+    int index = Class((int)header->size);
+
+    if (index >= 0 && cache_counts[index] < cache_limit) {
+        CachedBlock* cached = static_cast<CachedBlock*>(block);
+        cached->next = cache_heads[index];
+        cache_heads[index] = cached;
+        cache_counts[index]++;
+        return;
+    }
+
+    free(header);
+}
+
+void* PoolAllocator::Realloc(void* block, int size) {
+    int old_size = Size(block);
+    if (Roundup(size) == old_size) return block;
+
+    void* result = Malloc(size);
+    if (result == NULL) return NULL;
+    memcpy(result, block, old_size < size ? old_size : size);
+    Free(block);
+    return result;
+}
+
+int PoolAllocator::Size(void* block) {
+    if (block == NULL) return 0;
+    return (int)(static_cast<Header*>(block) - 1)->size;
+}
+
+int PoolAllocator::Init(void* data) {
+    int index = 0;
+    for (int i = 0; i <= max_cached / 16; i++) {
+        while (class_sizes[index] < i * 16) index++;
+        class_table[i] = (unsigned char)index;
+    }
+    return SQLITE_OK;
+}
+
+void PoolAllocator::Shutdown(void* data) {
+}
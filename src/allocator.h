@@ -0,0 +1,36 @@
+#ifndef NODE_SQLITE3_SRC_ALLOCATOR_H
+#define NODE_SQLITE3_SRC_ALLOCATOR_H
+
+#include <sqlite3.h>
+
+namespace node_sqlite3 {
+
+// Memory allocator for SQLITE_CONFIG_MALLOC. Small blocks are rounded up to
+// a few size classes and freed blocks are kept in a cache of the freeing
+// thread, so that the threadpool threads mostly reuse their own memory
+// instead of contending for the arenas of the system allocator.
+class PoolAllocator {
+public:
+    static const sqlite3_mem_methods methods;
+
+    // Blocks of up to this size are cached.
+    static const int max_cached = 4096;
+    // Cached blocks per size class and thread. Blocks cached by a thread
+    // that exits are not returned to the system.
+    static const unsigned int cache_limit = 64;
+
+protected:
+    static void* Malloc(int size);
+    static void Free(void* block);
+    static void* Realloc(void* block, int size);
+    static int Size(void* block);
+    static int Roundup(int size);
+    static int Init(void* data);
+    static void Shutdown(void* data);
+
+    static int Class(int size);
+};
+
+}
+
+#endif
@@ -4,45 +4,180 @@
 #include "threading.h"
 #include <node_version.h>
 
+#include <vector>
+
 #if defined(NODE_SQLITE3_BOOST_THREADING)
 #include <boost/thread/mutex.hpp>
 #endif
 
 
-// Generic uv_async handler.
+// Bounded lock-free queue for any number of producer threads and a single
+// consumer, after Dmitry Vyukov's bounded MPMC queue. Every cell carries a
+// sequence number that tells producers whether it is free and the consumer
+// whether it has been filled. The capacity is rounded up to a power of two.
+template <class T> class Ring {
+public:
+    explicit Ring(unsigned long capacity) : head(0), tail(0) {
+        unsigned long size = 2;
+        while (size < capacity) size <<= 1;
+        mask = size - 1;
+        cells = new Cell[size];
+        for (unsigned long i = 0; i < size; i++) {
+            cells[i].sequence = i;
+        }
+    }
+
+    ~Ring() {
+        delete[] cells;
+    }
+
+    // Returns false when the queue is full.
+    bool push(const T& value) {
+        Cell* cell;
+        unsigned long pos = head;
+        while (true) {
+            cell = &cells[pos & mask];
+            NODE_SQLITE3_MEMORY_BARRIER
+            long diff = (long)(cell->sequence - pos);
+            if (diff == 0) {
+                if (NODE_SQLITE3_ATOMIC_CAS(&head, pos, pos + 1)) break;
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            pos = head;
+        }
+        cell->value = value;
+        NODE_SQLITE3_MEMORY_BARRIER
+        cell->sequence = pos + 1;
+        return true;
+    }
+
+    // Must only be called by the consumer. Returns false when empty.
+    bool pop(T& value) {
+        Cell* cell = &cells[tail & mask];
+        NODE_SQLITE3_MEMORY_BARRIER
+        if ((long)(cell->sequence - (tail + 1)) < 0) {
+            return false;
+        }
+        value = cell->value;
+        NODE_SQLITE3_MEMORY_BARRIER
+        cell->sequence = tail + mask + 1;
+        tail++;
+        return true;
+    }
+
+protected:
+    struct Cell {
+        volatile unsigned long sequence;
+        T value;
+    };
+
+    Cell* cells;
+    unsigned long mask;
+    volatile unsigned long head;
+    // Keeps the producers' and the consumer's position on separate lines.
+    char padding[64];
+    unsigned long tail;
+
+private:
+    Ring(const Ring&);
+    Ring& operator=(const Ring&);
+};
+
+
+// Generic uv_async handler. Items are passed through a Ring, and a wake-up
+// is only sent when the handler isn't already due to run. Producers often
+// hold a connection mutex that the loop thread may be waiting for, so they
+// never wait for room: items that don't fit go to a locked overflow list.
+// The watcher keeps the loop alive only while items wait to be delivered.
+// uv_ref isn't thread-safe, so items pushed by workers rely on the work
+// request that pushes them until the loop thread sees them.
 template <class Item, class Parent> class Async {
     typedef void (*Callback)(Parent* parent, Item* item);
 
 protected:
     uv_async_t watcher;
+    Ring<Item*> items;
+    volatile unsigned long signaled;
+    // Set while the overflow list isn't empty. Producers then append to it
+    // as well, so that their items stay in order.
+    volatile unsigned long overflowed;
     NODE_SQLITE3_MUTEX_t
-    std::vector<Item*> data;
+    std::vector<Item*> overflow;
+    // Items pushed but not yet delivered.
+    volatile unsigned long queued;
+    bool referenced;
+    unsigned long loop_thread;
     Callback callback;
 public:
     Parent* parent;
 
 public:
-    Async(Parent* parent_, Callback cb_)
-        : callback(cb_), parent(parent_) {
+    Async(Parent* parent_, Callback cb_, unsigned long capacity = 1024)
+        : items(capacity), signaled(0), overflowed(0), queued(0),
+          referenced(true), loop_thread(uv_thread_self()),
+          callback(cb_), parent(parent_) {
         watcher.data = this;
         NODE_SQLITE3_MUTEX_INIT
         uv_async_init(uv_default_loop(), &watcher, listener);
+        unref();
     }
 
-    static void listener(uv_async_t* handle, int status) {
-        Async* async = static_cast<Async*>(handle->data);
-        std::vector<Item*> rows;
-        NODE_SQLITE3_MUTEX_LOCK(&async->mutex)
-        rows.swap(async->data);
-        NODE_SQLITE3_MUTEX_UNLOCK(&async->mutex)
-        for (unsigned int i = 0, size = rows.size(); i < size; i++) {
+    // ref and unref must be called on the loop thread.
+    void ref() {
+        if (referenced) return;
+        referenced = true;
+#if NODE_VERSION_AT_LEAST(0, 7, 9)
+        uv_ref((uv_handle_t *)&watcher);
+#else
+        uv_ref(uv_default_loop());
+#endif
+    }
+
+    void unref() {
+        if (!referenced) return;
+        referenced = false;
 #if NODE_VERSION_AT_LEAST(0, 7, 9)
-            uv_unref((uv_handle_t *)&async->watcher);
+        uv_unref((uv_handle_t *)&watcher);
 #else
-            uv_unref(uv_default_loop());
+        uv_unref(uv_default_loop());
 #endif
-            async->callback(async->parent, rows[i]);
+    }
+
+    static void listener(uv_async_t* handle, int status) {
+        Async* async = static_cast<Async*>(handle->data);
+        // Reset before draining: items pushed from now on send a new wake-up.
+        async->signaled = 0;
+        NODE_SQLITE3_MEMORY_BARRIER
+        async->drain();
+    }
+
+    void drain() {
+        Item* item;
+        while (items.pop(item)) {
+            NODE_SQLITE3_ATOMIC_SUB(&queued, 1)
+            callback(parent, item);
+        }
+
+        NODE_SQLITE3_MEMORY_BARRIER
+        if (overflowed) {
+            std::vector<Item*> spilled;
+            NODE_SQLITE3_MUTEX_LOCK(&mutex)
+            spilled.swap(overflow);
+            overflowed = 0;
+            NODE_SQLITE3_MUTEX_UNLOCK(&mutex)
+            NODE_SQLITE3_ATOMIC_SUB(&queued, spilled.size())
+            for (unsigned int i = 0, size = spilled.size(); i < size; i++) {
+                callback(parent, spilled[i]);
+            }
         }
+
+        // Items that arrived meanwhile have sent a new wake-up; keep the
+        // loop alive until it ran.
+        NODE_SQLITE3_MEMORY_BARRIER
+        if (queued) ref();
+        else unref();
     }
 
     static void close(uv_handle_t* handle) {
@@ -52,38 +187,40 @@ public:
         delete async;
     }
 
+    ~Async() {
+        NODE_SQLITE3_MUTEX_DESTROY
+    }
+
     void finish() {
-        // Need to call the listener again to ensure all items have been
-        // processed. Is this a bug in uv_async? Feels like uv_close
-        // should handle that.
-        listener(&watcher, 0);
+        // Deliver the items that were pushed since the last wake-up.
+        drain();
         uv_close((uv_handle_t*)&watcher, close);
     }
 
     void add(Item* item) {
-        // Make sure node runs long enough to deliver the messages.
-#if NODE_VERSION_AT_LEAST(0, 7, 9)
-        uv_ref((uv_handle_t *)&watcher);
-#else
-        uv_ref(uv_default_loop());
-#endif
-        NODE_SQLITE3_MUTEX_LOCK(&mutex);
-        data.push_back(item);
+        NODE_SQLITE3_ATOMIC_ADD(&queued, 1)
+        NODE_SQLITE3_MEMORY_BARRIER
+        if (!overflowed && items.push(item)) {
+            return;
+        }
+        NODE_SQLITE3_MUTEX_LOCK(&mutex)
+        overflow.push_back(item);
+        overflowed = 1;
         NODE_SQLITE3_MUTEX_UNLOCK(&mutex)
     }
 
     void send() {
-        uv_async_send(&watcher);
+        // Items pushed by sync calls have no work request behind them.
+        if (uv_thread_self() == loop_thread) ref();
+        if (NODE_SQLITE3_ATOMIC_CAS(&signaled, 0, 1)) {
+            uv_async_send(&watcher);
+        }
     }
 
     void send(Item* item) {
         add(item);
         send();
     }
-
-    ~Async() {
-        NODE_SQLITE3_MUTEX_DESTROY
-    }
 };
 
 #endif
@@ -0,0 +1,450 @@
+#include <string.h>
+#include <node.h>
+#include <node_buffer.h>
+#include <node_version.h>
+
+#include "macros.h"
+#include "database.h"
+#include "blob.h"
+#include "function.h"
+
+using namespace node_sqlite3;
+
+Persistent<FunctionTemplate> Blob::constructor_template;
+
+void Blob::Init(Handle<Object> target) {
+    HandleScope scope;
+
+    Local<FunctionTemplate> t = FunctionTemplate::New(New);
+
+    constructor_template = Persistent<FunctionTemplate>::New(t);
+    constructor_template->InstanceTemplate()->SetInternalFieldCount(1);
+    constructor_template->SetClassName(String::NewSymbol("Blob"));
+
+    NODE_SET_PROTOTYPE_METHOD(constructor_template, "read", Read);
+    NODE_SET_PROTOTYPE_METHOD(constructor_template, "write", Write);
+    NODE_SET_PROTOTYPE_METHOD(constructor_template, "close", Close);
+
+    target->Set(String::NewSymbol("Blob"),
+        constructor_template->GetFunction());
+}
+
+// { Database db, String table, String column, Number rowid, Boolean writable, Function callback }
+Handle<Value> Blob::New(const Arguments& args) {
+    HandleScope scope;
+
+    if (!args.IsConstructCall()) {
+        return ThrowException(Exception::TypeError(
+            String::New("Use the new operator to create new Blob objects"))
+        );
+    }
+
+    if (args.Length() <= 0 || !Database::HasInstance(args[0])) {
+        return ThrowException(Exception::TypeError(
+            String::New("Database object expected")));
+    }
+    REQUIRE_ARGUMENT_STRING(1, table);
+    REQUIRE_ARGUMENT_STRING(2, column);
+    if (args.Length() <= 3 || !args[3]->IsNumber()) {
+        return ThrowException(Exception::TypeError(
+            String::New("Argument 3 must be a number")));
+    }
+    OPTIONAL_ARGUMENT_FUNCTION(5, callback);
+
+    Database* db = ObjectWrap::Unwrap<Database>(args[0]->ToObject());
+    Blob* blob = new Blob(db);
+    blob->Wrap(args.This());
+
+    OpenBaton* baton = new OpenBaton(blob, callback);
+    baton->table = *table;
+    baton->column = *column;
+    baton->rowid = args[3]->IntegerValue();
+    baton->writable = args.Length() > 4 && args[4]->BooleanValue();
+    db->Schedule(Work_BeginOpen, baton);
+
+    return args.This();
+}
+
+void Blob::Work_BeginOpen(Database::Baton* baton) {
+    Begin(baton, Work_Open, (uv_after_work_cb)Work_AfterOpen);
+}
+
+void Blob::Work_Open(uv_work_t* req) {
+    OpenBaton* baton = static_cast<OpenBaton*>(req->data);
+    Blob* blob = baton->blob;
+    Database* db = baton->db;
+    sqlite3* handle = db->handle;
+
+    sqlite3_mutex* mtx = sqlite3_db_mutex(handle);
+    sqlite3_mutex_enter(mtx);
+
+    if (baton->writable && db->group.open) {
+        // The implicit transaction couldn't commit while the blob is open.
+        baton->commit_status = db->GroupCommitWork(baton->committed,
+            baton->commit_message);
+    }
+
+    baton->status = sqlite3_blob_open(handle, "main", baton->table.c_str(),
+        baton->column.c_str(), baton->rowid, baton->writable ? 1 : 0, &blob->handle);
+
+    if (baton->status != SQLITE_OK) {
+        baton->message = std::string(sqlite3_errmsg(handle));
+        sqlite3_blob_close(blob->handle);
+        blob->handle = NULL;
+    }
+    else {
+        blob->length = sqlite3_blob_bytes(blob->handle);
+        if (baton->writable) {
+            blob->writable = true;
+            db->group.writable_blobs++;
+        }
+    }
+
+    db->UpdateCommitted();
+    db->LeaveConnection(mtx);
+}
+
+void Blob::Work_AfterOpen(uv_work_t* req) {
+    HandleScope scope;
+    OpenBaton* baton = static_cast<OpenBaton*>(req->data);
+    Blob* blob = baton->blob;
+    Database* db = baton->db;
+
+    db->pending--;
+
+    if (baton->committed) {
+        db->GroupCommitted(baton->committed, baton->commit_status,
+            baton->commit_message);
+    }
+
+    Local<Value> argv[1];
+    if (baton->status != SQLITE_OK) {
+        EXCEPTION(String::New(baton->message.c_str()), baton->status, exception);
+        argv[0] = exception;
+        blob->Close();
+    }
+    else {
+        blob->locked = false;
+        db->blobs.push_back(blob);
+        blob->handle_->Set(String::NewSymbol("length"), Integer::New(blob->length), ReadOnly);
+        argv[0] = Local<Value>::New(Null());
+    }
+
+    if (!baton->callback.IsEmpty() && baton->callback->IsFunction()) {
+        TRY_CATCH_CALL(blob->handle_, baton->callback, 1, argv);
+    }
+    else if (baton->status != SQLITE_OK) {
+        Local<Value> args[] = { String::NewSymbol("error"), argv[0] };
+        EMIT_EVENT(blob->handle_, 2, args);
+    }
+
+    db->Process();
+
+    delete baton;
+}
+
+// Returns the error to throw when another operation is in progress.
+Local<Value> Blob::BusyError() {
+    const char* message = NULL;
+    if (closed) {
+        message = "Blob is closed";
+    }
+    else if (locked) {
+        message = "Blob is busy";
+    }
+
+    if (message == NULL) {
+        return Local<Value>();
+    }
+    EXCEPTION(String::New(message), SQLITE_MISUSE, exception);
+    return exception;
+}
+
+void Blob::Begin(Database::Baton* baton, uv_work_cb work, uv_after_work_cb after) {
+    assert(baton->db->open);
+    baton->db->pending++;
+    baton->db->QueueWork(&baton->request, work, after);
+}
+
+void Blob::Unlock() {
+    locked = false;
+    db->pending--;
+}
+
+void Blob::End(Baton* baton) {
+    db->Process();
+    delete baton;
+}
+
+// Blob#read(offset, length, [callback])
+Handle<Value> Blob::Read(const Arguments& args) {
+    HandleScope scope;
+    Blob* blob = ObjectWrap::Unwrap<Blob>(args.This());
+
+    REQUIRE_ARGUMENTS(2);
+    OPTIONAL_ARGUMENT_INTEGER(0, offset, 0);
+    OPTIONAL_ARGUMENT_INTEGER(1, length, 0);
+    OPTIONAL_ARGUMENT_FUNCTION(2, callback);
+
+    Local<Value> error = blob->BusyError();
+    if (!error.IsEmpty()) {
+        return ThrowException(error);
+    }
+    if (offset < 0 || length < 0) {
+        return ThrowException(Exception::RangeError(
+            String::New("Offset and length must not be negative")));
+    }
+
+    // Reads stop at the end of the value.
+    if (offset > blob->length) offset = blob->length;
+    if (length > blob->length - offset) length = blob->length - offset;
+
+    Baton* baton = new ReadBaton(blob, callback, offset, length);
+    blob->locked = true;
+    blob->db->Schedule(Work_BeginRead, baton);
+
+    return args.This();
+}
+
+void Blob::Work_BeginRead(Database::Baton* baton) {
+    Begin(baton, Work_Read, (uv_after_work_cb)Work_AfterRead);
+}
+
+void Blob::Work_Read(uv_work_t* req) {
+    ReadBaton* baton = static_cast<ReadBaton*>(req->data);
+    Blob* blob = baton->blob;
+    sqlite3* handle = blob->db->handle;
+
+    baton->data = (char*)malloc(baton->length ? baton->length : 1);
+
+    sqlite3_mutex* mtx = sqlite3_db_mutex(handle);
+    sqlite3_mutex_enter(mtx);
+
+    baton->status = sqlite3_blob_read(blob->handle, baton->data,
+        baton->length, baton->offset);
+    if (baton->status != SQLITE_OK) {
+        baton->message = std::string(sqlite3_errmsg(handle));
+    }
+
+    blob->db->LeaveConnection(mtx);
+}
+
+void Blob::Work_AfterRead(uv_work_t* req) {
+    HandleScope scope;
+    ReadBaton* baton = static_cast<ReadBaton*>(req->data);
+    Blob* blob = baton->blob;
+
+    Local<Value> argv[2];
+    if (baton->status != SQLITE_OK) {
+        EXCEPTION(String::New(baton->message.c_str()), baton->status, exception);
+        argv[0] = exception;
+        argv[1] = Local<Value>::New(Undefined());
+    }
+    else {
+        // The Buffer takes over the allocation.
+        char* data = baton->data;
+        baton->data = NULL;
+        argv[0] = Local<Value>::New(Null());
+#if NODE_VERSION_AT_LEAST(0, 11, 3)
+        argv[1] = Local<Value>::New(Buffer::New(data, baton->length, FreeData, NULL));
+#else
+        argv[1] = Local<Value>::New(Buffer::New(data, baton->length, FreeData, NULL)->handle_);
+#endif
+    }
+
+    blob->Unlock();
+
+    if (!baton->callback.IsEmpty() && baton->callback->IsFunction()) {
+        TRY_CATCH_CALL(blob->handle_, baton->callback, 2, argv);
+    }
+    else if (baton->status != SQLITE_OK) {
+        Local<Value> args[] = { String::NewSymbol("error"), argv[0] };
+        EMIT_EVENT(blob->handle_, 2, args);
+    }
+
+    blob->End(baton);
+}
+
+Blob::WriteBaton::WriteBaton(Blob* blob_, Handle<Function> cb_, int offset_,
+        Handle<Object> buffer_) : Baton(blob_, cb_), offset(offset_) {
+    buffer = Persistent<Object>::New(buffer_);
+    data = Buffer::Data(buffer_);
+    length = Buffer::Length(buffer_);
+}
+
+// Blob#write(offset, buffer, [callback])
+// Writes can't change the size of the value.
+Handle<Value> Blob::Write(const Arguments& args) {
+    HandleScope scope;
+    Blob* blob = ObjectWrap::Unwrap<Blob>(args.This());
+
+    REQUIRE_ARGUMENTS(2);
+    OPTIONAL_ARGUMENT_INTEGER(0, offset, 0);
+    if (!Buffer::HasInstance(args[1])) {
+        return ThrowException(Exception::TypeError(
+            String::New("Argument 1 must be a Buffer")));
+    }
+    OPTIONAL_ARGUMENT_FUNCTION(2, callback);
+
+    Local<Value> error = blob->BusyError();
+    if (!error.IsEmpty()) {
+        return ThrowException(error);
+    }
+    if (offset < 0) {
+        return ThrowException(Exception::RangeError(
+            String::New("Offset must not be negative")));
+    }
+
+    Baton* baton = new WriteBaton(blob, callback, offset, args[1]->ToObject());
+    blob->locked = true;
+    blob->db->Schedule(Work_BeginWrite, baton);
+
+    return args.This();
+}
+
+void Blob::Work_BeginWrite(Database::Baton* baton) {
+    Begin(baton, Work_Write, (uv_after_work_cb)Work_AfterWrite);
+}
+
+void Blob::Work_Write(uv_work_t* req) {
+    WriteBaton* baton = static_cast<WriteBaton*>(req->data);
+    Blob* blob = baton->blob;
+    sqlite3* handle = blob->db->handle;
+
+    sqlite3_mutex* mtx = sqlite3_db_mutex(handle);
+    sqlite3_mutex_enter(mtx);
+
+    baton->status = sqlite3_blob_write(blob->handle, baton->data,
+        baton->length, baton->offset);
+    if (baton->status != SQLITE_OK) {
+        baton->message = std::string(sqlite3_errmsg(handle));
+    }
+
+    blob->db->LeaveConnection(mtx);
+}
+
+void Blob::Work_AfterWrite(uv_work_t* req) {
+    HandleScope scope;
+    WriteBaton* baton = static_cast<WriteBaton*>(req->data);
+    Blob* blob = baton->blob;
+
+    Local<Value> argv[1];
+    if (baton->status != SQLITE_OK) {
+        EXCEPTION(String::New(baton->message.c_str()), baton->status, exception);
+        argv[0] = exception;
+    }
+    else {
+        argv[0] = Local<Value>::New(Null());
+    }
+
+    blob->Unlock();
+
+    if (!baton->callback.IsEmpty() && baton->callback->IsFunction()) {
+        TRY_CATCH_CALL(blob->handle_, baton->callback, 1, argv);
+    }
+    else if (baton->status != SQLITE_OK) {
+        Local<Value> args[] = { String::NewSymbol("error"), argv[0] };
+        EMIT_EVENT(blob->handle_, 2, args);
+    }
+
+    blob->End(baton);
+}
+
+// Blob#close([callback])
+Handle<Value> Blob::Close(const Arguments& args) {
+    HandleScope scope;
+    Blob* blob = ObjectWrap::Unwrap<Blob>(args.This());
+    OPTIONAL_ARGUMENT_FUNCTION(0, callback);
+
+    Local<Value> error = blob->BusyError();
+    if (!error.IsEmpty()) {
+        return ThrowException(error);
+    }
+
+    Baton* baton = new Baton(blob, callback);
+    blob->locked = true;
+    blob->db->Schedule(Work_BeginClose, baton);
+
+    return args.This();
+}
+
+void Blob::Work_BeginClose(Database::Baton* baton) {
+    Begin(baton, Work_Close, (uv_after_work_cb)Work_AfterClose);
+}
+
+void Blob::Work_Close(uv_work_t* req) {
+    Baton* baton = static_cast<Baton*>(req->data);
+    Blob* blob = baton->blob;
+
+    sqlite3_mutex* mtx = sqlite3_db_mutex(blob->db->handle);
+    sqlite3_mutex_enter(mtx);
+
+    // Closing a writable blob commits the write when the connection is in
+    // autocommit mode, which may fail.
+    baton->status = sqlite3_blob_close(blob->handle);
+    blob->handle = NULL;
+    if (blob->writable) {
+        blob->writable = false;
+        blob->db->group.writable_blobs--;
+    }
+    if (baton->status != SQLITE_OK) {
+        baton->message = std::string(sqlite3_errmsg(blob->db->handle));
+    }
+
+    blob->db->UpdateCommitted();
+    blob->db->LeaveConnection(mtx);
+}
+
+void Blob::Work_AfterClose(uv_work_t* req) {
+    HandleScope scope;
+    Baton* baton = static_cast<Baton*>(req->data);
+    Blob* blob = baton->blob;
+
+    blob->Close();
+
+    Local<Value> argv[1];
+    if (baton->status != SQLITE_OK) {
+        EXCEPTION(String::New(baton->message.c_str()), baton->status, exception);
+        argv[0] = exception;
+    }
+    else {
+        argv[0] = Local<Value>::New(Null());
+    }
+
+    blob->Unlock();
+
+    if (!baton->callback.IsEmpty() && baton->callback->IsFunction()) {
+        TRY_CATCH_CALL(blob->handle_, baton->callback, 1, argv);
+    }
+    else if (baton->status != SQLITE_OK) {
+        Local<Value> args[] = { String::NewSymbol("error"), argv[0] };
+        EMIT_EVENT(blob->handle_, 2, args);
+    }
+
+    blob->End(baton);
+}
+
+void Blob::Close() {
+    assert(!closed);
+    closed = true;
+    if (handle != NULL) {
+        ConnectionLock lock(db->bridge, db->handle);
+        sqlite3_blob_close(handle);
+        handle = NULL;
+        if (writable) {
+            writable = false;
+            db->group.writable_blobs--;
+        }
+    }
+    for (unsigned int i = 0; i < db->blobs.size(); i++) {
+        if (db->blobs[i] == this) {
+            db->blobs.erase(db->blobs.begin() + i);
+            break;
+        }
+    }
+    db->Unref();
+}
+
+void Blob::FreeData(char* data, void* hint) {
+    free(data);
+}
@@ -0,0 +1,135 @@
+#ifndef NODE_SQLITE3_SRC_BLOB_H
+#define NODE_SQLITE3_SRC_BLOB_H
+
+#include <node.h>
+
+#include "database.h"
+
+#include <cstdlib>
+#include <string>
+
+#include <sqlite3.h>
+
+using namespace v8;
+using namespace node;
+
+namespace node_sqlite3 {
+
+// Incremental I/O on a single BLOB value. Reads and writes run in the thread
+// pool on a chunk at a time, so the whole value never has to be in memory.
+// Only one operation can be in progress at a time. Operations are scheduled
+// on the database like its other calls, so they follow serialize() and wait
+// for exclusive calls.
+class Blob : public ObjectWrap {
+public:
+    static Persistent<FunctionTemplate> constructor_template;
+
+    static void Init(Handle<Object> target);
+    static Handle<Value> New(const Arguments& args);
+
+    struct Baton : Database::Baton {
+        Blob* blob;
+        Baton(Blob* blob_, Handle<Function> cb_) :
+                Database::Baton(blob_->db, cb_), blob(blob_) {
+            blob->Ref();
+        }
+        virtual ~Baton() {
+            blob->Unref();
+        }
+    };
+
+    struct OpenBaton : Baton {
+        std::string table;
+        std::string column;
+        sqlite3_int64 rowid;
+        bool writable;
+        // The implicit transaction that was committed before opening.
+        unsigned int committed;
+        int commit_status;
+        std::string commit_message;
+        OpenBaton(Blob* blob_, Handle<Function> cb_) :
+            Baton(blob_, cb_), rowid(0), writable(false), committed(0),
+            commit_status(SQLITE_OK) {}
+    };
+
+    struct ReadBaton : Baton {
+        int offset;
+        int length;
+        char* data;
+        ReadBaton(Blob* blob_, Handle<Function> cb_, int offset_, int length_) :
+            Baton(blob_, cb_), offset(offset_), length(length_), data(NULL) {}
+        virtual ~ReadBaton() {
+            free(data);
+        }
+    };
+
+    struct WriteBaton : Baton {
+        int offset;
+        // Keeps the Buffer alive while the worker reads from it.
+        Persistent<Object> buffer;
+        const char* data;
+        int length;
+        WriteBaton(Blob* blob_, Handle<Function> cb_, int offset_, Handle<Object> buffer_);
+        virtual ~WriteBaton() {
+            buffer.Dispose();
+        }
+    };
+
+    Blob(Database* db_) : ObjectWrap(),
+            db(db_),
+            handle(NULL),
+            length(0),
+            locked(true),
+            closed(false),
+            writable(false) {
+        db->Ref();
+    }
+
+    ~Blob() {
+        if (!closed) Close();
+    }
+
+    // Closes the handle right away; used when the database is closed.
+    void Close();
+
+    static Handle<Value> Read(const Arguments& args);
+    static void Work_BeginRead(Database::Baton* baton);
+    static void Work_Read(uv_work_t* req);
+    static void Work_AfterRead(uv_work_t* req);
+
+    static Handle<Value> Write(const Arguments& args);
+    static void Work_BeginWrite(Database::Baton* baton);
+    static void Work_Write(uv_work_t* req);
+    static void Work_AfterWrite(uv_work_t* req);
+
+    static Handle<Value> Close(const Arguments& args);
+    static void Work_BeginClose(Database::Baton* baton);
+    static void Work_Close(uv_work_t* req);
+    static void Work_AfterClose(uv_work_t* req);
+
+protected:
+    static void Work_BeginOpen(Database::Baton* baton);
+    static void Work_Open(uv_work_t* req);
+    static void Work_AfterOpen(uv_work_t* req);
+
+    static void FreeData(char* data, void* hint);
+
+    Local<Value> BusyError();
+    static void Begin(Database::Baton* baton, uv_work_cb work, uv_after_work_cb after);
+    // Called before the callback runs so that it can start the next
+    // operation; End then finishes the baton.
+    void Unlock();
+    void End(Baton* baton);
+
+protected:
+    Database* db;
+    sqlite3_blob* handle;
+    int length;
+    bool locked;
+    bool closed;
+    bool writable;
+};
+
+}
+
+#endif
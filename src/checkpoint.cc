@@ -0,0 +1,93 @@
+#include <node.h>
+
+#include "checkpoint.h"
+
+using namespace node_sqlite3;
+
+Checkpointer::Checkpointer(sqlite3* connection_, int pages_) :
+        connection(connection_), pages(pages_), requested(false),
+        stopping(false) {
+    NODE_SQLITE3_MUTEX_INIT
+    NODE_SQLITE3_COND_INIT
+    // A RESTART checkpoint keeps new writers out while it waits for the
+    // readers, so it doesn't wait long.
+    sqlite3_busy_timeout(connection, 100);
+    int status = uv_thread_create(&thread, Run, this);
+    assert(status == 0);
+}
+
+Checkpointer::~Checkpointer() {
+    NODE_SQLITE3_MUTEX_LOCK(&mutex)
+    stopping = true;
+    NODE_SQLITE3_COND_SIGNAL(&cond)
+    NODE_SQLITE3_MUTEX_UNLOCK(&mutex)
+
+    uv_thread_join(&thread);
+    sqlite3_close(connection);
+
+    NODE_SQLITE3_COND_DESTROY
+    NODE_SQLITE3_MUTEX_DESTROY
+}
+
+int Checkpointer::WalHook(void* data, sqlite3* db, const char* name, int frames) {
+    Checkpointer* checkpointer = static_cast<Checkpointer*>(data);
+    if (frames >= checkpointer->pages) {
+        NODE_SQLITE3_MUTEX_LOCK(&checkpointer->mutex)
+        checkpointer->requested = true;
+        NODE_SQLITE3_COND_SIGNAL(&checkpointer->cond)
+        NODE_SQLITE3_MUTEX_UNLOCK(&checkpointer->mutex)
+    }
+    return SQLITE_OK;
+}
+
+Checkpointer::Counters Checkpointer::GetCounters() {
+    NODE_SQLITE3_MUTEX_LOCK(&mutex)
+    Counters result = counters;
+    NODE_SQLITE3_MUTEX_UNLOCK(&mutex)
+    return result;
+}
+
+void Checkpointer::Run(void* data) {
+    Checkpointer* checkpointer = static_cast<Checkpointer*>(data);
+
+    NODE_SQLITE3_MUTEX_LOCK(&checkpointer->mutex)
+    while (true) {
+        while (!checkpointer->requested && !checkpointer->stopping) {
+            NODE_SQLITE3_COND_WAIT(&checkpointer->cond, &checkpointer->mutex)
+        }
+        if (checkpointer->stopping) break;
+        // Commits made while checkpointing request another one.
+        checkpointer->requested = false;
+        NODE_SQLITE3_MUTEX_UNLOCK(&checkpointer->mutex)
+
+        checkpointer->Checkpoint();
+
+        NODE_SQLITE3_MUTEX_LOCK(&checkpointer->mutex)
+    }
+    NODE_SQLITE3_MUTEX_UNLOCK(&checkpointer->mutex)
+}
+
+void Checkpointer::Checkpoint() {
+    int frames = 0;
+    int copied = 0;
+    bool restarted = false;
+    int status = sqlite3_wal_checkpoint_v2(connection, NULL,
+        SQLITE_CHECKPOINT_PASSIVE, &frames, &copied);
+
+    // Readers that still use the log keep a passive checkpoint from copying
+    // all of it, and the log can't start over while they do. Once it has
+    // grown to several times the threshold, wait for them briefly so that
+    // the next writer restarts the log instead of growing it further.
+    if (status == SQLITE_OK && copied < frames && frames >= 4 * pages) {
+        restarted = true;
+        status = sqlite3_wal_checkpoint_v2(connection, NULL,
+            SQLITE_CHECKPOINT_RESTART, &frames, &copied);
+    }
+
+    NODE_SQLITE3_MUTEX_LOCK(&mutex)
+    counters.checkpoints++;
+    if (restarted) counters.restarts++;
+    if (status != SQLITE_OK || copied < frames) counters.incomplete++;
+    counters.frames = frames;
+    NODE_SQLITE3_MUTEX_UNLOCK(&mutex)
+}
@@ -0,0 +1,61 @@
+#ifndef NODE_SQLITE3_SRC_CHECKPOINT_H
+#define NODE_SQLITE3_SRC_CHECKPOINT_H
+
+#include <node.h>
+
+#include "threading.h"
+
+#include <sqlite3.h>
+
+namespace node_sqlite3 {
+
+// Checkpoints the write-ahead log of a database on a thread and connection
+// of its own. It replaces SQLite's automatic checkpoints, which run inside
+// whichever commit crosses the threshold: the WAL hook of the primary
+// connection only wakes the thread once the log has grown past the
+// configured number of pages.
+class Checkpointer {
+public:
+    // Takes ownership of the connection.
+    Checkpointer(sqlite3* connection, int pages);
+    ~Checkpointer();
+
+    // Installed with sqlite3_wal_hook on the writing connection. Runs on the
+    // committing worker with the connection's mutex held, so it only signals
+    // the checkpoint thread.
+    static int WalHook(void* data, sqlite3* db, const char* name, int frames);
+
+    struct Counters {
+        Counters() : checkpoints(0), restarts(0), incomplete(0), frames(0) {}
+        // Passive checkpoints that were run.
+        double checkpoints;
+        // Passive checkpoints that were escalated to RESTART.
+        double restarts;
+        // Checkpoints that couldn't copy the whole log, because readers
+        // were still using it or the database was busy.
+        double incomplete;
+        // Size of the log when it was last checkpointed.
+        int frames;
+    };
+
+    Counters GetCounters();
+    int Pages() const { return pages; }
+
+protected:
+    static void Run(void* data);
+    void Checkpoint();
+
+    sqlite3* connection;
+    int pages;
+
+    uv_thread_t thread;
+    NODE_SQLITE3_MUTEX_t
+    NODE_SQLITE3_COND_t
+    bool requested;
+    bool stopping;
+    Counters counters;
+};
+
+}
+
+#endif
@@ -4,6 +4,8 @@
 #include "macros.h"
 #include "database.h"
 #include "statement.h"
+#include "blob.h"
+#include "function.h"
 
 using namespace node_sqlite3;
 
@@ -22,9 +24,16 @@ void Database::Init(Handle<Object> target) {
     NODE_SET_PROTOTYPE_METHOD(constructor_template, "exec", Exec);
     NODE_SET_PROTOTYPE_METHOD(constructor_template, "wait", Wait);
     NODE_SET_PROTOTYPE_METHOD(constructor_template, "loadExtension", LoadExtension);
+    NODE_SET_PROTOTYPE_METHOD(constructor_template, "backup", Backup);
     NODE_SET_PROTOTYPE_METHOD(constructor_template, "serialize", Serialize);
     NODE_SET_PROTOTYPE_METHOD(constructor_template, "parallelize", Parallelize);
     NODE_SET_PROTOTYPE_METHOD(constructor_template, "configure", Configure);
+    NODE_SET_PROTOTYPE_METHOD(constructor_template, "statementCacheStats", StatementCacheStats);
+    NODE_SET_PROTOTYPE_METHOD(constructor_template, "checkpointStats", CheckpointStats);
+    NODE_SET_PROTOTYPE_METHOD(constructor_template, "stats", Stats);
+    NODE_SET_PROTOTYPE_METHOD(constructor_template, "status", Status);
+    NODE_SET_PROTOTYPE_METHOD(constructor_template, "interrupt", Interrupt);
+    NODE_SET_PROTOTYPE_METHOD(constructor_template, "registerFunction", RegisterFunction);
 
     NODE_SET_GETTER(constructor_template, "open", OpenGetter);
 
@@ -32,6 +41,29 @@ void Database::Init(Handle<Object> target) {
         constructor_template->GetFunction());
 }
 
+Database::~Database() {
+    RemoveCallbacks();
+    if (group.timer) {
+        uv_close((uv_handle_t*)group.timer, GroupTimerClosed);
+        group.timer = NULL;
+    }
+    delete statement_cache;
+    statement_cache = NULL;
+    delete checkpointer;
+    checkpointer = NULL;
+    for (unsigned int i = 0; i < readers.size(); i++) {
+        sqlite3_close(readers[i]);
+    }
+    readers.clear();
+    sqlite3_close(handle);
+    handle = NULL;
+    open = false;
+    RemoveFunctions();
+    delete stats;
+    stats = NULL;
+    if (worker) worker->Release();
+}
+
 void Database::Process() {
     if (!open && locked && !queue.empty()) {
         EXCEPTION(String::New("Database handle is closed"), SQLITE_MISUSE, exception);
@@ -68,6 +100,15 @@ void Database::Process() {
             break;
         }
 
+        if (call->callback == Work_BeginClose && backups > 0) {
+            break;
+        }
+
+        if (NeedsGroupCommit(call->callback)) {
+            GroupFlush();
+            break;
+        }
+
         queue.pop();
         locked = call->exclusive;
         call->callback(call->baton);
@@ -77,6 +118,23 @@ void Database::Process() {
     }
 }
 
+// Releases the mutex of a connection on a worker. A main thread that waits
+// for it in a ConnectionLock tries again right away.
+void Database::LeaveConnection(sqlite3_mutex* mtx) {
+    sqlite3_mutex_leave(mtx);
+    if (bridge) bridge->Released();
+}
+
+void Database::QueueWork(uv_work_t* req, uv_work_cb work, uv_after_work_cb after) {
+    if (worker) {
+        worker->Queue(req, work, after);
+    }
+    else {
+        int status = uv_queue_work(uv_default_loop(), req, work, after);
+        assert(status == 0);
+    }
+}
+
 void Database::Schedule(Work_Callback callback, Baton* baton, bool exclusive) {
     if (!open && locked) {
         EXCEPTION(String::New("Database is closed"), SQLITE_MISUSE, exception);
@@ -91,7 +149,13 @@ void Database::Schedule(Work_Callback callback, Baton* baton, bool exclusive) {
         return;
     }
 
-    if (!open || ((locked || exclusive || serialize) && pending > 0)) {
+    if (open && NeedsGroupCommit(callback)) {
+        // Let the implicit transaction commit first.
+        queue.push(new Call(callback, baton, true));
+        GroupFlush();
+    }
+    else if (!open || ((locked || exclusive || serialize) && pending > 0) ||
+            (callback == Work_BeginClose && backups > 0)) {
         queue.push(new Call(callback, baton, exclusive || serialize));
     }
     else {
@@ -119,12 +183,145 @@ Handle<Value> Database::New(const Arguments& args) {
         mode = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX;
     }
 
+    int readers = 0;
+    bool thread = false;
+    std::string thread_group;
+    std::string journal_mode;
+    std::string synchronous;
+    int checkpoint_pages = 0;
+    sqlite3_int64 mmap_size = -1;
+    int cache_size = 0;
+    bool immutable = false;
+    int lookaside_size = -1, lookaside_count = -1;
+    if (args.Length() >= pos && args[pos]->IsObject() && !args[pos]->IsFunction()) {
+        Local<Object> options = args[pos++]->ToObject();
+        if (options->Has(String::NewSymbol("readers"))) {
+            Local<Value> value = options->Get(String::NewSymbol("readers"));
+            if (!value->IsInt32() || value->Int32Value() < 0) {
+                return ThrowException(Exception::TypeError(
+                    String::New("readers must be a non-negative integer"))
+                );
+            }
+            readers = value->Int32Value();
+        }
+        if (options->Has(String::NewSymbol("thread"))) {
+            // true runs the database on a thread of its own; a string names a
+            // thread that is shared with other databases of the same name.
+            Local<Value> value = options->Get(String::NewSymbol("thread"));
+            if (value->IsString()) {
+                thread = true;
+                thread_group = *String::Utf8Value(value);
+            }
+            else if (value->IsBoolean()) {
+                thread = value->BooleanValue();
+            }
+            else {
+                return ThrowException(Exception::TypeError(
+                    String::New("thread must be a boolean or a string"))
+                );
+            }
+        }
+        if (options->Has(String::NewSymbol("journalMode"))) {
+            journal_mode = *String::Utf8Value(options->Get(String::NewSymbol("journalMode")));
+            for (unsigned int i = 0; i < journal_mode.size(); i++) {
+                journal_mode[i] = tolower(journal_mode[i]);
+            }
+            if (journal_mode != "delete" && journal_mode != "truncate" &&
+                    journal_mode != "persist" && journal_mode != "memory" &&
+                    journal_mode != "wal" && journal_mode != "off") {
+                return ThrowException(Exception::TypeError(
+                    String::New("journalMode must be one of delete, truncate, persist, memory, wal or off"))
+                );
+            }
+        }
+        if (options->Has(String::NewSymbol("synchronous"))) {
+            synchronous = *String::Utf8Value(options->Get(String::NewSymbol("synchronous")));
+            for (unsigned int i = 0; i < synchronous.size(); i++) {
+                synchronous[i] = tolower(synchronous[i]);
+            }
+            if (synchronous != "off" && synchronous != "normal" && synchronous != "full") {
+                return ThrowException(Exception::TypeError(
+                    String::New("synchronous must be one of off, normal or full"))
+                );
+            }
+        }
+        if (options->Has(String::NewSymbol("checkpoint"))) {
+            // true or { pages: n } checkpoints the write-ahead log on a
+            // thread of its own once it has grown to n pages.
+            Local<Value> value = options->Get(String::NewSymbol("checkpoint"));
+            if (value->IsObject()) {
+                GET_INTEGER(value->ToObject(), pages, "pages");
+                checkpoint_pages = pages > 0 ? pages : 1000;
+            }
+            else if (value->IsBoolean()) {
+                checkpoint_pages = value->BooleanValue() ? 1000 : 0;
+            }
+            else {
+                return ThrowException(Exception::TypeError(
+                    String::New("checkpoint must be a boolean or an object"))
+                );
+            }
+        }
+        if (options->Has(String::NewSymbol("mmapSize"))) {
+            // Bytes of the database file that are accessed through a memory
+            // mapping instead of read() calls and page cache copies.
+            Local<Value> value = options->Get(String::NewSymbol("mmapSize"));
+            if (!value->IsNumber() || value->NumberValue() < 0) {
+                return ThrowException(Exception::TypeError(
+                    String::New("mmapSize must be a non-negative number"))
+                );
+            }
+            mmap_size = (sqlite3_int64)value->NumberValue();
+        }
+        if (options->Has(String::NewSymbol("cacheSize"))) {
+            // Pages of the page cache of each connection, or KiB if negative.
+            Local<Value> value = options->Get(String::NewSymbol("cacheSize"));
+            if (!value->IsInt32() || value->Int32Value() == 0) {
+                return ThrowException(Exception::TypeError(
+                    String::New("cacheSize must be a non-zero integer"))
+                );
+            }
+            cache_size = value->Int32Value();
+        }
+        if (options->Has(String::NewSymbol("immutable"))) {
+            // The file is opened read-only and assumed not to change while
+            // it is open.
+            immutable = options->Get(String::NewSymbol("immutable"))->BooleanValue();
+            if (immutable) {
+                mode = (mode & ~(SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE)) |
+                    SQLITE_OPEN_READONLY;
+            }
+        }
+        if (options->Has(String::NewSymbol("lookaside"))) {
+            // Size and number of the slots of each connection's lookaside
+            // allocator, which serves its small short-lived allocations.
+            Local<Value> value = options->Get(String::NewSymbol("lookaside"));
+            if (value->IsObject()) {
+                GET_INTEGER(value->ToObject(), size, "size");
+                GET_INTEGER(value->ToObject(), count, "count");
+                lookaside_size = size;
+                lookaside_count = count;
+            }
+            if (lookaside_size < 0 || lookaside_count < 0) {
+                return ThrowException(Exception::TypeError(
+                    String::New("lookaside needs a non-negative size and count"))
+                );
+            }
+        }
+        if (checkpoint_pages > 0 && !journal_mode.empty() && journal_mode != "wal") {
+            return ThrowException(Exception::TypeError(
+                String::New("checkpoint requires the wal journalMode"))
+            );
+        }
+    }
+
     Local<Function> callback;
     if (args.Length() >= pos && args[pos]->IsFunction()) {
         callback = Local<Function>::Cast(args[pos++]);
     }
 
     Database* db = new Database();
+    if (thread) db->worker = Worker::Acquire(thread_group);
     db->Wrap(args.This());
 
     args.This()->Set(String::NewSymbol("filename"), args[0]->ToString(), ReadOnly);
@@ -132,15 +329,32 @@ Handle<Value> Database::New(const Arguments& args) {
 
     // Start opening the database.
     OpenBaton* baton = new OpenBaton(db, callback, *filename, mode);
+    // Every connection to a memory database gets a database of its own.
+    if (baton->filename != ":memory:" && !baton->filename.empty()) {
+        baton->readers = readers;
+        if (mode & SQLITE_OPEN_READWRITE) {
+            baton->checkpoint_pages = checkpoint_pages;
+        }
+    }
+    // Background checkpoints are only useful with a write-ahead log.
+    if (journal_mode.empty() && baton->checkpoint_pages > 0) {
+        journal_mode = "wal";
+    }
+    baton->journal_mode = journal_mode;
+    baton->synchronous = synchronous;
+    baton->mmap_size = mmap_size;
+    baton->cache_size = cache_size;
+    baton->immutable = immutable;
+    baton->lookaside_size = lookaside_size;
+    baton->lookaside_count = lookaside_count;
     Work_BeginOpen(baton);
 
     return args.This();
 }
 
 void Database::Work_BeginOpen(Baton* baton) {
-    int status = uv_queue_work(uv_default_loop(),
-        &baton->request, Work_Open, (uv_after_work_cb)Work_AfterOpen);
-    assert(status == 0);
+    baton->db->QueueWork(&baton->request,
+        Work_Open, (uv_after_work_cb)Work_AfterOpen);
 }
 
 void Database::Work_Open(uv_work_t* req) {
@@ -163,6 +377,125 @@ void Database::Work_Open(uv_work_t* req) {
         // Set default database handle values.
         sqlite3_busy_timeout(db->handle, 1000);
     }
+
+    if (baton->status == SQLITE_OK) {
+        baton->status = ConfigureConnection(db->handle, baton);
+    }
+    if (baton->status == SQLITE_OK && !baton->journal_mode.empty()) {
+        std::string sql = "PRAGMA journal_mode=" + baton->journal_mode;
+        baton->status = sqlite3_exec(db->handle, sql.c_str(), NULL, NULL, NULL);
+    }
+    if (baton->status == SQLITE_OK && !baton->synchronous.empty()) {
+        std::string sql = "PRAGMA synchronous=" + baton->synchronous;
+        baton->status = sqlite3_exec(db->handle, sql.c_str(), NULL, NULL, NULL);
+    }
+    if (baton->status == SQLITE_OK && baton->checkpoint_pages > 0) {
+        int mode = baton->mode & ~SQLITE_OPEN_CREATE;
+        sqlite3* connection = NULL;
+        baton->status = sqlite3_open_v2(baton->filename.c_str(), &connection, mode, NULL);
+        if (baton->status != SQLITE_OK) {
+            baton->message = std::string(sqlite3_errmsg(connection));
+            sqlite3_close(connection);
+        }
+        else {
+            // Setting a WAL hook turns off the automatic checkpoints.
+            db->checkpointer = new Checkpointer(connection, baton->checkpoint_pages);
+            sqlite3_wal_hook(db->handle, Checkpointer::WalHook, db->checkpointer);
+        }
+    }
+    if (baton->status != SQLITE_OK && db->handle) {
+        if (baton->message.empty()) {
+            baton->message = std::string(sqlite3_errmsg(db->handle));
+        }
+        sqlite3_close(db->handle);
+        db->handle = NULL;
+    }
+
+    if (baton->status == SQLITE_OK && baton->readers > 0) {
+        // With a write-ahead log, readers don't block the writer and vice
+        // versa. This fails for read-only databases, which is fine.
+        if ((baton->mode & SQLITE_OPEN_READWRITE) && baton->journal_mode.empty()) {
+            sqlite3_exec(db->handle, "PRAGMA journal_mode=WAL", NULL, NULL, NULL);
+        }
+
+        int mode = (baton->mode & ~(SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE)) |
+            SQLITE_OPEN_READONLY;
+        for (int i = 0; i < baton->readers; i++) {
+            sqlite3* reader = NULL;
+            baton->status = sqlite3_open_v2(baton->filename.c_str(), &reader, mode, NULL);
+            if (baton->status != SQLITE_OK) {
+                baton->message = std::string(sqlite3_errmsg(reader));
+                sqlite3_close(reader);
+                break;
+            }
+            sqlite3_busy_timeout(reader, 1000);
+            baton->status = ConfigureConnection(reader, baton);
+            if (baton->status != SQLITE_OK) {
+                baton->message = std::string(sqlite3_errmsg(reader));
+                sqlite3_close(reader);
+                break;
+            }
+            db->readers.push_back(reader);
+        }
+
+        if (baton->status != SQLITE_OK) {
+            for (unsigned int i = 0; i < db->readers.size(); i++) {
+                sqlite3_close(db->readers[i]);
+            }
+            db->readers.clear();
+            delete db->checkpointer;
+            db->checkpointer = NULL;
+            sqlite3_close(db->handle);
+            db->handle = NULL;
+        }
+        db->reader_load.assign(db->readers.size(), 0);
+    }
+}
+
+// Applies the per-connection options of the open call.
+int Database::ConfigureConnection(sqlite3* connection, OpenBaton* baton) {
+    int status = SQLITE_OK;
+    char sql[64];
+
+    if (baton->lookaside_size >= 0) {
+        // Has to come first, before the connection allocates anything.
+        status = sqlite3_db_config(connection, SQLITE_DBCONFIG_LOOKASIDE,
+            NULL, baton->lookaside_size, baton->lookaside_count);
+    }
+    if (status == SQLITE_OK && baton->mmap_size >= 0) {
+        sqlite3_snprintf(sizeof(sql), sql, "PRAGMA mmap_size=%lld", baton->mmap_size);
+        status = sqlite3_exec(connection, sql, NULL, NULL, NULL);
+    }
+    if (status == SQLITE_OK && baton->cache_size != 0) {
+        sqlite3_snprintf(sizeof(sql), sql, "PRAGMA cache_size=%d", baton->cache_size);
+        status = sqlite3_exec(connection, sql, NULL, NULL, NULL);
+    }
+    if (status == SQLITE_OK && baton->immutable &&
+            (baton->readers == 0 || !UsesWal(connection))) {
+        // The shared lock is kept after the first read, so that later reads
+        // neither lock the file again nor check whether the page cache is
+        // still valid. Writers of other processes are locked out meanwhile.
+        // With a write-ahead log the lock would be exclusive and keep the
+        // readers out, so they use the normal locking mode there.
+        status = sqlite3_exec(connection, "PRAGMA locking_mode=EXCLUSIVE", NULL, NULL, NULL);
+    }
+
+    return status;
+}
+
+// Whether the database file uses a write-ahead log. Reading the schema
+// version makes the connection look at the file header first.
+bool Database::UsesWal(sqlite3* connection) {
+    bool wal = false;
+    sqlite3_stmt* stmt = NULL;
+    if (sqlite3_exec(connection, "PRAGMA schema_version", NULL, NULL, NULL) == SQLITE_OK &&
+            sqlite3_prepare_v2(connection, "PRAGMA journal_mode", -1, &stmt, NULL) == SQLITE_OK &&
+            sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* mode = (const char*)sqlite3_column_text(stmt, 0);
+        wal = mode != NULL && sqlite3_strnicmp(mode, "wal", 4) == 0;
+    }
+    sqlite3_finalize(stmt);
+    return wal;
 }
 
 void Database::Work_AfterOpen(uv_work_t* req) {
@@ -220,16 +553,42 @@ void Database::Work_BeginClose(Baton* baton) {
     assert(baton->db->handle);
     assert(baton->db->pending == 0);
 
+    baton->db->closing = true;
     baton->db->RemoveCallbacks();
-    int status = uv_queue_work(uv_default_loop(),
-        &baton->request, Work_Close, (uv_after_work_cb)Work_AfterClose);
-    assert(status == 0);
+    // Open blobs would keep the connection from closing. Their later calls
+    // fail with "Blob is closed".
+    while (!baton->db->blobs.empty()) {
+        baton->db->blobs.back()->Close();
+    }
+    // Cached statements would keep the connection from closing.
+    if (baton->db->statement_cache) {
+        baton->db->statement_cache->Flush();
+    }
+    baton->db->QueueWork(&baton->request,
+        Work_Close, (uv_after_work_cb)Work_AfterClose);
 }
 
 void Database::Work_Close(uv_work_t* req) {
     Baton* baton = static_cast<Baton*>(req->data);
     Database* db = baton->db;
 
+    while (!db->readers.empty()) {
+        sqlite3* reader = db->readers.back();
+        baton->status = sqlite3_close(reader);
+        if (baton->status != SQLITE_OK) {
+            baton->message = std::string(sqlite3_errmsg(reader));
+            return;
+        }
+        db->readers.pop_back();
+    }
+
+    if (db->checkpointer) {
+        // Brings back the automatic checkpoints in case closing fails.
+        sqlite3_wal_autocheckpoint(db->handle, 1000);
+        delete db->checkpointer;
+        db->checkpointer = NULL;
+    }
+
     baton->status = sqlite3_close(db->handle);
 
     if (baton->status != SQLITE_OK) {
@@ -245,6 +604,8 @@ void Database::Work_AfterClose(uv_work_t* req) {
     Baton* baton = static_cast<Baton*>(req->data);
     Database* db = baton->db;
 
+    db->closing = false;
+
     Local<Value> argv[1];
     if (baton->status != SQLITE_OK) {
         EXCEPTION(String::New(baton->message.c_str()), baton->status, exception);
@@ -255,6 +616,11 @@ void Database::Work_AfterClose(uv_work_t* req) {
         // Leave db->locked to indicate that this db object has reached
         // the end of its life.
         argv[0] = Local<Value>::New(Null());
+        db->RemoveFunctions();
+        if (db->worker) {
+            db->worker->Release();
+            db->worker = NULL;
+        }
     }
 
     // Fire callbacks.
@@ -311,6 +677,25 @@ Handle<Value> Database::Parallelize(const Arguments& args) {
     return args.This();
 }
 
+// Database#interrupt()
+// Makes the statements currently stepping on any of the connections fail
+// with SQLITE_INTERRUPT. Queued calls are not affected. An interrupted write
+// rolls back the transaction it is part of; with group commit, the writes
+// of the implicit transaction fail with it.
+Handle<Value> Database::Interrupt(const Arguments& args) {
+    HandleScope scope;
+    Database* db = ObjectWrap::Unwrap<Database>(args.This());
+
+    if (db->open && !db->closing) {
+        sqlite3_interrupt(db->handle);
+        for (unsigned int i = 0; i < db->readers.size(); i++) {
+            sqlite3_interrupt(db->readers[i]);
+        }
+    }
+
+    return args.This();
+}
+
 Handle<Value> Database::Configure(const Arguments& args) {
     HandleScope scope;
     Database* db = ObjectWrap::Unwrap<Database>(args.This());
@@ -322,11 +707,34 @@ Handle<Value> Database::Configure(const Arguments& args) {
         Baton* baton = new Baton(db, handle);
         db->Schedule(RegisterTraceCallback, baton);
     }
+    else if (args[0]->Equals(String::NewSymbol("insert")) ||
+            args[0]->Equals(String::NewSymbol("update")) ||
+            args[0]->Equals(String::NewSymbol("delete"))) {
+        int type = args[0]->Equals(String::NewSymbol("insert")) ? SQLITE_INSERT :
+            args[0]->Equals(String::NewSymbol("update")) ? SQLITE_UPDATE : SQLITE_DELETE;
+        if (args[1]->BooleanValue()) {
+            db->update_types |= 1u << type;
+        }
+        else {
+            db->update_types &= ~(1u << type);
+        }
+        Local<Function> handle;
+        Baton* baton = new Baton(db, handle);
+        db->Schedule(RegisterUpdateCallback, baton);
+    }
     else if (args[0]->Equals(String::NewSymbol("profile"))) {
         Local<Function> handle;
         Baton* baton = new Baton(db, handle);
         db->Schedule(RegisterProfileCallback, baton);
     }
+    else if (args[0]->Equals(String::NewSymbol("stats"))) {
+        // Records the timings of all statements in native histograms that
+        // are read with Database#stats.
+        Local<Function> handle;
+        Baton* baton = new Baton(db, handle);
+        baton->status = args[1]->BooleanValue();
+        db->Schedule(RegisterStats, baton);
+    }
     else if (args[0]->Equals(String::NewSymbol("busyTimeout"))) {
         if (!args[1]->IsInt32()) {
             return ThrowException(Exception::TypeError(
@@ -338,6 +746,79 @@ Handle<Value> Database::Configure(const Arguments& args) {
         baton->status = args[1]->Int32Value();
         db->Schedule(SetBusyTimeout, baton);
     }
+    else if (args[0]->Equals(String::NewSymbol("eachBuffer"))) {
+        if (!args[1]->IsObject()) {
+            return ThrowException(Exception::TypeError(
+                String::New("Value must be an object"))
+            );
+        }
+        // Applies to each() calls that start from now on.
+        Local<Object> options = args[1]->ToObject();
+        GET_INTEGER(options, high_water, "highWaterMark");
+        GET_INTEGER(options, high_water_bytes, "highWaterBytes");
+        GET_INTEGER(options, chunk_size, "chunkSize");
+
+        EachLimits& limits = db->each_limits;
+        limits.high_water = high_water > 0 ? high_water : 0;
+        limits.high_water_bytes = high_water_bytes > 0 ? high_water_bytes : 0;
+        limits.low_water = limits.high_water / 2;
+        limits.low_water_bytes = limits.high_water_bytes / 2;
+        if (options->Has(String::NewSymbol("lowWaterMark"))) {
+            GET_INTEGER(options, low_water, "lowWaterMark");
+            limits.low_water = low_water > 0 ? low_water : 0;
+        }
+        limits.chunk_size = chunk_size > 0 ? chunk_size : 1;
+    }
+    else if (args[0]->Equals(String::NewSymbol("pinBuffers"))) {
+        // Applies to parameters bound from now on; Buffers are then bound
+        // with SQLITE_STATIC and must not be modified while in use.
+        db->pin_buffers = args[1]->BooleanValue();
+    }
+    else if (args[0]->Equals(String::NewSymbol("pipeline"))) {
+        // Consecutive queued bind, get, run and reset calls of a statement
+        // are executed in a single trip to the thread pool.
+        db->pipeline = args[1]->BooleanValue();
+    }
+    else if (args[0]->Equals(String::NewSymbol("groupCommit"))) {
+        GroupCommit& group = db->group;
+        if (args[1]->IsObject()) {
+            Local<Object> options = args[1]->ToObject();
+            if (options->Has(String::NewSymbol("maxRows"))) {
+                GET_INTEGER(options, max_rows, "maxRows");
+                group.max_rows = max_rows > 0 ? max_rows : 1;
+            }
+            if (options->Has(String::NewSymbol("maxDelayMs"))) {
+                GET_INTEGER(options, max_delay, "maxDelayMs");
+                group.max_delay = max_delay > 0 ? max_delay : 0;
+            }
+            group.enabled = true;
+        }
+        else {
+            group.enabled = args[1]->BooleanValue();
+        }
+
+        if (group.timer == NULL) {
+            group.timer = new uv_timer_t;
+            uv_timer_init(uv_default_loop(), group.timer);
+            group.timer->data = db;
+        }
+        if (!group.enabled && db->GroupDirty()) {
+            db->GroupFlush();
+        }
+    }
+    else if (args[0]->Equals(String::NewSymbol("statementCache"))) {
+        if (!args[1]->IsInt32() || args[1]->Int32Value() < 0) {
+            return ThrowException(Exception::TypeError(
+                String::New("Value must be a non-negative integer"))
+            );
+        }
+        // The maximum number of idle statements kept for Database#run, get,
+        // all, each and map. 0 disables the cache.
+        if (db->statement_cache == NULL) {
+            db->statement_cache = new StatementCache(db);
+        }
+        db->statement_cache->Resize(args[1]->Int32Value());
+    }
     else {
         return ThrowException(Exception::Error(String::Concat(
             args[0]->ToString(),
@@ -350,12 +831,340 @@ Handle<Value> Database::Configure(const Arguments& args) {
     return args.This();
 }
 
+Handle<Value> Database::StatementCacheStats(const Arguments& args) {
+    HandleScope scope;
+    Database* db = ObjectWrap::Unwrap<Database>(args.This());
+    StatementCache* cache = db->statement_cache;
+
+    Local<Object> stats = Object::New();
+    stats->Set(String::NewSymbol("capacity"), Integer::NewFromUnsigned(cache ? cache->Capacity() : 0));
+    stats->Set(String::NewSymbol("size"), Integer::NewFromUnsigned(cache ? cache->Size() : 0));
+    stats->Set(String::NewSymbol("hits"), Number::New(cache ? cache->hits : 0));
+    stats->Set(String::NewSymbol("misses"), Number::New(cache ? cache->misses : 0));
+    stats->Set(String::NewSymbol("evictions"), Number::New(cache ? cache->evictions : 0));
+
+    return scope.Close(stats);
+}
+
+Handle<Value> Database::Stats(const Arguments& args) {
+    HandleScope scope;
+    Database* db = ObjectWrap::Unwrap<Database>(args.This());
+
+    bool reset = args.Length() > 0 && args[0]->BooleanValue();
+
+    if (db->stats == NULL) {
+        return scope.Close(Object::New());
+    }
+    return scope.Close(db->stats->Snapshot(reset));
+}
+
+// Database#status([reset], callback)
+// Reads the sqlite3_db_status counters of all connections on the worker,
+// where waiting for the connection mutexes doesn't hold up the event loop.
+// With reset, the counters and high-water marks start over after the read.
+Handle<Value> Database::Status(const Arguments& args) {
+    HandleScope scope;
+    Database* db = ObjectWrap::Unwrap<Database>(args.This());
+
+    int pos = 0;
+    bool reset = false;
+    if (args.Length() > 0 && !args[0]->IsFunction()) {
+        reset = args[0]->BooleanValue();
+        pos = 1;
+    }
+    OPTIONAL_ARGUMENT_FUNCTION(pos, callback);
+
+    Baton* baton = new StatusBaton(db, callback, reset);
+    db->Schedule(Work_BeginStatus, baton);
+
+    return args.This();
+}
+
+void Database::Work_BeginStatus(Baton* baton) {
+    assert(baton->db->open);
+    assert(baton->db->handle);
+    baton->db->pending++;
+    baton->db->QueueWork(&baton->request,
+        Work_Status, (uv_after_work_cb)Work_AfterStatus);
+}
+
+void Database::Work_Status(uv_work_t* req) {
+    StatusBaton* baton = static_cast<StatusBaton*>(req->data);
+    Database* db = baton->db;
+
+    std::vector<sqlite3*> connections(db->readers);
+    connections.insert(connections.begin(), db->handle);
+
+    for (unsigned int i = 0; i < connections.size(); i++) {
+        for (int op = 0; op <= SQLITE_DBSTATUS_MAX; op++) {
+            int current = 0;
+            int highwater = 0;
+            int status = sqlite3_db_status(connections[i], op, &current,
+                &highwater, baton->reset);
+            if (status != SQLITE_OK) continue;
+
+            switch (op) {
+                // These only have a high-water mark.
+                case SQLITE_DBSTATUS_LOOKASIDE_HIT:
+                case SQLITE_DBSTATUS_LOOKASIDE_MISS_SIZE:
+                case SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL:
+                    baton->values[op] += highwater;
+                    break;
+                case SQLITE_DBSTATUS_LOOKASIDE_USED:
+                    baton->highwater += highwater;
+                    // Fall through.
+                default:
+                    baton->values[op] += current;
+            }
+        }
+    }
+}
+
+void Database::Work_AfterStatus(uv_work_t* req) {
+    HandleScope scope;
+    StatusBaton* baton = static_cast<StatusBaton*>(req->data);
+    Database* db = baton->db;
+
+    db->pending--;
+
+    if (!baton->callback.IsEmpty() && baton->callback->IsFunction()) {
+        Local<Object> status = Object::New();
+        status->Set(String::NewSymbol("cacheUsed"), Number::New(baton->values[SQLITE_DBSTATUS_CACHE_USED]));
+        status->Set(String::NewSymbol("cacheHit"), Number::New(baton->values[SQLITE_DBSTATUS_CACHE_HIT]));
+        status->Set(String::NewSymbol("cacheMiss"), Number::New(baton->values[SQLITE_DBSTATUS_CACHE_MISS]));
+        status->Set(String::NewSymbol("cacheWrite"), Number::New(baton->values[SQLITE_DBSTATUS_CACHE_WRITE]));
+        status->Set(String::NewSymbol("schemaUsed"), Number::New(baton->values[SQLITE_DBSTATUS_SCHEMA_USED]));
+        status->Set(String::NewSymbol("stmtUsed"), Number::New(baton->values[SQLITE_DBSTATUS_STMT_USED]));
+        status->Set(String::NewSymbol("lookasideUsed"), Number::New(baton->values[SQLITE_DBSTATUS_LOOKASIDE_USED]));
+        status->Set(String::NewSymbol("lookasideHighwater"), Number::New(baton->highwater));
+        status->Set(String::NewSymbol("lookasideHit"), Number::New(baton->values[SQLITE_DBSTATUS_LOOKASIDE_HIT]));
+        status->Set(String::NewSymbol("lookasideMissSize"), Number::New(baton->values[SQLITE_DBSTATUS_LOOKASIDE_MISS_SIZE]));
+        status->Set(String::NewSymbol("lookasideMissFull"), Number::New(baton->values[SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL]));
+
+        Local<Value> argv[] = { Local<Value>::New(Null()), status };
+        TRY_CATCH_CALL(db->handle_, baton->callback, 2, argv);
+    }
+
+    db->Process();
+    delete baton;
+}
+
+Handle<Value> Database::CheckpointStats(const Arguments& args) {
+    HandleScope scope;
+    Database* db = ObjectWrap::Unwrap<Database>(args.This());
+    // The checkpointer is deleted on the worker while closing.
+    Checkpointer* checkpointer = db->closing ? NULL : db->checkpointer;
+
+    Checkpointer::Counters counters;
+    if (checkpointer) counters = checkpointer->GetCounters();
+
+    Local<Object> stats = Object::New();
+    stats->Set(String::NewSymbol("pages"), Integer::New(checkpointer ? checkpointer->Pages() : 0));
+    stats->Set(String::NewSymbol("checkpoints"), Number::New(counters.checkpoints));
+    stats->Set(String::NewSymbol("restarts"), Number::New(counters.restarts));
+    stats->Set(String::NewSymbol("incomplete"), Number::New(counters.incomplete));
+    stats->Set(String::NewSymbol("frames"), Integer::New(counters.frames));
+
+    return scope.Close(stats);
+}
+
+// Called on the worker with the mutex of the statement's connection held,
+// right before a write is stepped. Returns the generation of the implicit
+// transaction the write joined or 0 if it runs on its own.
+unsigned int Database::GroupJoin(sqlite3_stmt* stmt) {
+    if (!group.enabled || sqlite3_db_handle(stmt) != handle ||
+            sqlite3_stmt_readonly(stmt)) {
+        return 0;
+    }
+
+    if (!group.open) {
+        // The application started a transaction of its own.
+        if (!sqlite3_get_autocommit(handle)) return 0;
+        if (group.writable_blobs) return 0;
+        if (sqlite3_exec(handle, "BEGIN", NULL, NULL, NULL) != SQLITE_OK) return 0;
+        group.open = true;
+        group.generation++;
+    }
+
+    return group.generation;
+}
+
+// Called on the worker with the mutex of the primary connection held.
+// Commits the implicit transaction if one is open and returns the latest
+// generation, which is now finished.
+int Database::GroupCommitWork(unsigned int& generation, std::string& message) {
+    int status = SQLITE_OK;
+    if (group.open) {
+        status = sqlite3_exec(handle, "COMMIT", NULL, NULL, NULL);
+        if (status != SQLITE_OK) {
+            message = std::string(sqlite3_errmsg(handle));
+            sqlite3_exec(handle, "ROLLBACK", NULL, NULL, NULL);
+        }
+        group.open = false;
+    }
+    generation = group.generation;
+    return status;
+}
+
+void Database::GroupDefer(Handle<Object> stmt, Handle<Function> callback,
+        sqlite3_int64 inserted_id, int changes, unsigned int generation) {
+    if (generation > group.reported) group.reported = generation;
+
+    if (!callback.IsEmpty() && callback->IsFunction()) {
+        GroupWrite* write = new GroupWrite();
+        write->stmt = Persistent<Object>::New(stmt);
+        write->callback = Persistent<Function>::New(callback);
+        write->inserted_id = inserted_id;
+        write->changes = changes;
+        write->generation = generation;
+        group_writes.push_back(write);
+    }
+
+    if (generation <= group.committed) {
+        // Already committed while this write was reported.
+        GroupCommitted(group.committed, SQLITE_OK, std::string());
+    }
+    else if (++group.rows >= group.max_rows) {
+        GroupFlush();
+    }
+    else {
+        GroupArm();
+    }
+}
+
+// Fires the callbacks of the writes up to and including the generation.
+void Database::GroupCommitted(unsigned int generation, int status,
+        const std::string& message) {
+    HandleScope scope;
+    if (generation > group.committed) group.committed = generation;
+
+    Local<Value> argv[1];
+    if (status != SQLITE_OK) {
+        EXCEPTION(String::New(message.c_str()), status, exception);
+        argv[0] = exception;
+    }
+    else {
+        argv[0] = Local<Value>::New(Null());
+    }
+
+    bool called = false;
+    std::vector<GroupWrite*> writes;
+    writes.swap(group_writes);
+    for (unsigned int i = 0; i < writes.size(); i++) {
+        GroupWrite* write = writes[i];
+        if (write->generation > generation) {
+            group_writes.push_back(write);
+            continue;
+        }
+
+        if (status == SQLITE_OK) {
+            write->stmt->Set(String::NewSymbol("lastID"), Local<Integer>(Integer::New(write->inserted_id)));
+            write->stmt->Set(String::NewSymbol("changes"), Local<Integer>(Integer::New(write->changes)));
+        }
+        TRY_CATCH_CALL(write->stmt, write->callback, 1, argv);
+        called = true;
+
+        write->stmt.Dispose();
+        write->callback.Dispose();
+        delete write;
+    }
+
+    if (status != SQLITE_OK && !called) {
+        Local<Value> args[] = { String::NewSymbol("error"), argv[0] };
+        EMIT_EVENT(handle_, 2, args);
+    }
+}
+
+// Commits the implicit transaction in the thread pool.
+void Database::GroupFlush() {
+    if (group.timing) {
+        uv_timer_stop(group.timer);
+        group.timing = false;
+        Unref();
+    }
+    group.rows = 0;
+
+    if (group.committing || !open) return;
+    group.committing = true;
+    pending++;
+
+    GroupCommitBaton* baton = new GroupCommitBaton(this);
+    QueueWork(&baton->request,
+        Work_GroupCommit, (uv_after_work_cb)Work_AfterGroupCommit);
+}
+
+// Makes sure the implicit transaction is committed after the maximum delay.
+void Database::GroupArm() {
+    if (group.timing) return;
+    group.timing = true;
+    // Keep the database alive until the timer fires.
+    Ref();
+    uv_timer_start(group.timer, GroupTimeout, group.max_delay, 0);
+}
+
+bool Database::NeedsGroupCommit(Work_Callback callback) {
+    // Exclusive operations wait for the deferred callbacks.
+    return GroupDirty() && (callback == Work_BeginExec ||
+        callback == Work_BeginClose || callback == Work_Wait ||
+        callback == Work_BeginLoadExtension);
+}
+
+void Database::GroupTimeout(uv_timer_t* handle, int status) {
+    Database* db = static_cast<Database*>(handle->data);
+    db->group.timing = false;
+    db->GroupFlush();
+    db->Unref();
+}
+
+void Database::GroupTimerClosed(uv_handle_t* handle) {
+    delete (uv_timer_t*)handle;
+}
+
+void Database::Work_GroupCommit(uv_work_t* req) {
+    GroupCommitBaton* baton = static_cast<GroupCommitBaton*>(req->data);
+    Database* db = baton->db;
+
+    sqlite3_mutex* mtx = sqlite3_db_mutex(db->handle);
+    sqlite3_mutex_enter(mtx);
+    baton->status = db->GroupCommitWork(baton->generation, baton->message);
+    db->UpdateCommitted();
+    db->LeaveConnection(mtx);
+}
+
+void Database::Work_AfterGroupCommit(uv_work_t* req) {
+    HandleScope scope;
+    GroupCommitBaton* baton = static_cast<GroupCommitBaton*>(req->data);
+    Database* db = baton->db;
+
+    db->group.committing = false;
+    db->pending--;
+    db->GroupCommitted(baton->generation, baton->status, baton->message);
+
+    // Writes that were reported while committing started a new generation.
+    if (db->GroupDirty()) {
+        db->GroupArm();
+    }
+
+    db->Process();
+
+    delete baton;
+}
+
 void Database::SetBusyTimeout(Baton* baton) {
     assert(baton->db->open);
     assert(baton->db->handle);
 
+    Database* db = baton->db;
+
     // Abuse the status field for passing the timeout.
-    sqlite3_busy_timeout(baton->db->handle, baton->status);
+    {
+        ConnectionLock lock(db->bridge, db->handle);
+        sqlite3_busy_timeout(db->handle, baton->status);
+    }
+    for (unsigned int i = 0; i < db->readers.size(); i++) {
+        ConnectionLock lock(db->bridge, db->readers[i]);
+        sqlite3_busy_timeout(db->readers[i], baton->status);
+    }
 
     delete baton;
 }
@@ -368,11 +1177,11 @@ void Database::RegisterTraceCallback(Baton* baton) {
     if (db->debug_trace == NULL) {
         // Add it.
         db->debug_trace = new AsyncTrace(db, TraceCallback);
-        sqlite3_trace(db->handle, TraceCallback, db);
+        db->SetTraceHook(true);
     }
     else {
         // Remove it.
-        sqlite3_trace(db->handle, NULL, NULL);
+        db->SetTraceHook(false);
         db->debug_trace->finish();
         db->debug_trace = NULL;
     }
@@ -380,6 +1189,23 @@ void Database::RegisterTraceCallback(Baton* baton) {
     delete baton;
 }
 
+// Workers call the hook while holding the mutex of their connection, so the
+// main thread takes it through a ConnectionLock to avoid waiting for a worker
+// that waits for a user function.
+void Database::SetTraceHook(bool enabled) {
+    void (*callback)(void*, const char*) = NULL;
+    if (enabled) callback = TraceCallback;
+
+    {
+        ConnectionLock lock(bridge, handle);
+        sqlite3_trace(handle, callback, enabled ? this : NULL);
+    }
+    for (unsigned int i = 0; i < readers.size(); i++) {
+        ConnectionLock lock(bridge, readers[i]);
+        sqlite3_trace(readers[i], callback, enabled ? this : NULL);
+    }
+}
+
 void Database::TraceCallback(void* db, const char* sql) {
     // Note: This function is called in the thread pool.
     // Note: Some queries, such as "EXPLAIN" queries, are not sent through this.
@@ -405,25 +1231,73 @@ void Database::RegisterProfileCallback(Baton* baton) {
     if (db->debug_profile == NULL) {
         // Add it.
         db->debug_profile = new AsyncProfile(db, ProfileCallback);
-        sqlite3_profile(db->handle, ProfileCallback, db);
+        db->SetProfileHook();
     }
     else {
-        // Remove it.
-        sqlite3_profile(db->handle, NULL, NULL);
-        db->debug_profile->finish();
+        // Remove it. The hook must be gone before the handle is finished.
+        AsyncProfile* profile = db->debug_profile;
         db->debug_profile = NULL;
+        db->SetProfileHook();
+        profile->finish();
     }
 
     delete baton;
 }
 
-void Database::ProfileCallback(void* db, const char* sql, sqlite3_uint64 nsecs) {
+void Database::RegisterStats(Baton* baton) {
+    assert(baton->db->open);
+    assert(baton->db->handle);
+    Database* db = baton->db;
+
+    if (baton->status && db->stats == NULL) {
+        db->stats = new QueryStats();
+    }
+    db->stats_enabled = baton->status;
+    db->SetProfileHook();
+
+    delete baton;
+}
+
+// The profile event and the stats option share the connections' profile
+// hook, which is installed while either of them is enabled. Once this
+// returns, no worker uses the previous hook anymore.
+void Database::SetProfileHook() {
+    ProfileHook* previous = profile_hook;
+    profile_hook = NULL;
+    if (debug_profile || stats_enabled) {
+        profile_hook = new ProfileHook(debug_profile, stats_enabled ? stats : NULL);
+    }
+
+    void (*callback)(void*, const char*, sqlite3_uint64) = NULL;
+    if (profile_hook) callback = ProfileCallback;
+
+    if (handle) {
+        {
+            ConnectionLock lock(bridge, handle);
+            sqlite3_profile(handle, callback, profile_hook);
+        }
+        for (unsigned int i = 0; i < readers.size(); i++) {
+            ConnectionLock lock(bridge, readers[i]);
+            sqlite3_profile(readers[i], callback, profile_hook);
+        }
+    }
+
+    delete previous;
+}
+
+void Database::ProfileCallback(void* hook_, const char* sql, sqlite3_uint64 nsecs) {
     // Note: This function is called in the thread pool.
     // Note: Some queries, such as "EXPLAIN" queries, are not sent through this.
-    ProfileInfo* info = new ProfileInfo();
-    info->sql = std::string(sql);
-    info->nsecs = nsecs;
-    static_cast<Database*>(db)->debug_profile->send(info);
+    ProfileHook* hook = static_cast<ProfileHook*>(hook_);
+    if (hook->stats) {
+        hook->stats->Record(sql, nsecs);
+    }
+    if (hook->profile) {
+        ProfileInfo* info = new ProfileInfo();
+        info->sql = std::string(sql);
+        info->nsecs = nsecs;
+        hook->profile->send(info);
+    }
 }
 
 void Database::ProfileCallback(Database *db, ProfileInfo* info) {
@@ -442,14 +1316,26 @@ void Database::RegisterUpdateCallback(Baton* baton) {
     assert(baton->db->handle);
     Database* db = baton->db;
 
-    if (db->update_event == NULL) {
+    // A worker may be writing on the primary connection meanwhile.
+    ConnectionLock lock(db->bridge, db->handle);
+    db->update_filter = db->update_types;
+
+    if (db->update_types && db->update_event == NULL) {
         // Add it.
         db->update_event = new AsyncUpdate(db, UpdateCallback);
         sqlite3_update_hook(db->handle, UpdateCallback, db);
+        sqlite3_commit_hook(db->handle, CommitCallback, db);
+        sqlite3_rollback_hook(db->handle, RollbackCallback, db);
     }
-    else {
+    else if (!db->update_types && db->update_event != NULL) {
         // Remove it.
         sqlite3_update_hook(db->handle, NULL, NULL);
+        sqlite3_commit_hook(db->handle, NULL, NULL);
+        sqlite3_rollback_hook(db->handle, NULL, NULL);
+        delete db->update_batch;
+        db->update_batch = NULL;
+        delete db->update_committing;
+        db->update_committing = NULL;
         db->update_event->finish();
         db->update_event = NULL;
     }
@@ -457,29 +1343,115 @@ void Database::RegisterUpdateCallback(Baton* baton) {
     delete baton;
 }
 
-void Database::UpdateCallback(void* db, int type, const char* database,
+void Database::UpdateCallback(void* db_, int type, const char* database,
         const char* table, sqlite3_int64 rowid) {
     // Note: This function is called in the thread pool.
     // Note: Some queries, such as "EXPLAIN" queries, are not sent through this.
-    UpdateInfo* info = new UpdateInfo();
-    info->type = type;
-    info->database = std::string(database);
-    info->table = std::string(table);
-    info->rowid = rowid;
-    static_cast<Database*>(db)->update_event->send(info);
+    Database* db = static_cast<Database*>(db_);
+    if (!(db->update_filter & (1u << type))) {
+        return;
+    }
+    if (db->update_batch == NULL) {
+        db->update_batch = new UpdateBatch();
+    }
+    db->update_batch->push_back(UpdateInfo());
+    UpdateInfo& info = db->update_batch->back();
+    info.type = type;
+    info.database = std::string(database);
+    info.table = std::string(table);
+    info.rowid = rowid;
+}
+
+int Database::CommitCallback(void* db_) {
+    // Note: This function is called in the thread pool.
+    // Runs before the transaction is committed, which may still fail. The
+    // changes are handed off by UpdateCommitted once it is done.
+    Database* db = static_cast<Database*>(db_);
+    if (db->update_batch != NULL) {
+        if (db->update_committing == NULL) {
+            db->update_committing = db->update_batch;
+        }
+        else {
+            // A previous COMMIT failed and left the transaction open.
+            db->update_committing->insert(db->update_committing->end(),
+                db->update_batch->begin(), db->update_batch->end());
+            delete db->update_batch;
+        }
+        db->update_batch = NULL;
+    }
+    return 0;
+}
+
+void Database::RollbackCallback(void* db_) {
+    // Note: This function is called in the thread pool.
+    Database* db = static_cast<Database*>(db_);
+    delete db->update_batch;
+    db->update_batch = NULL;
+    delete db->update_committing;
+    db->update_committing = NULL;
+}
+
+// Called on the worker with the mutex of the primary connection held, after
+// it ran statements there. Sends the changes of a transaction once its
+// COMMIT finished. When the COMMIT failed without rolling back, e.g. with
+// SQLITE_BUSY, the changes stay with the open transaction.
+void Database::UpdateCommitted() {
+    if (update_committing == NULL) {
+        return;
+    }
+    if (sqlite3_get_autocommit(handle)) {
+        update_event->send(update_committing);
+    }
+    else {
+        if (update_batch != NULL) {
+            update_committing->insert(update_committing->end(),
+                update_batch->begin(), update_batch->end());
+            delete update_batch;
+        }
+        update_batch = update_committing;
+    }
+    update_committing = NULL;
 }
 
-void Database::UpdateCallback(Database *db, UpdateInfo* info) {
+// Called on the worker with the mutex of the primary connection held. Drops
+// the changes recorded after UpdateMark when a failed statement or a
+// ROLLBACK TO undid them, neither of which fires the rollback hook.
+void Database::UpdateUndo(size_t mark) {
+    if (update_batch != NULL && update_batch->size() > mark) {
+        update_batch->erase(update_batch->begin() + mark, update_batch->end());
+    }
+}
+
+void Database::UpdateCallback(Database *db, UpdateBatch* batch) {
     HandleScope scope;
 
-    Local<Value> argv[] = {
-        String::NewSymbol(sqlite_authorizer_string(info->type)),
-        String::New(info->database.c_str()),
-        String::New(info->table.c_str()),
-        Integer::New(info->rowid),
-    };
-    EMIT_EVENT(db->handle_, 4, argv);
-    delete info;
+    // One event per type with all changes of the transaction.
+    static const int types[] = { SQLITE_INSERT, SQLITE_UPDATE, SQLITE_DELETE };
+    for (unsigned int t = 0; t < sizeof(types) / sizeof(types[0]); t++) {
+        int type = types[t];
+        if (!(db->update_types & (1u << type))) continue;
+
+        Local<Array> changes = Array::New();
+        unsigned int count = 0;
+        for (unsigned int i = 0; i < batch->size(); i++) {
+            const UpdateInfo& info = (*batch)[i];
+            if (info.type != type) continue;
+            Local<Object> change = Object::New();
+            change->Set(String::NewSymbol("database"), String::New(info.database.c_str()));
+            change->Set(String::NewSymbol("table"), String::New(info.table.c_str()));
+            change->Set(String::NewSymbol("rowid"), Number::New(info.rowid));
+            changes->Set(count++, change);
+        }
+
+        if (count) {
+            Local<Value> argv[] = {
+                String::NewSymbol(sqlite_authorizer_string(type)),
+                changes
+            };
+            EMIT_EVENT(db->handle_, 2, argv);
+        }
+    }
+    delete batch;
 }
 
 Handle<Value> Database::Exec(const Arguments& args) {
@@ -500,17 +1472,20 @@ void Database::Work_BeginExec(Baton* baton) {
     assert(baton->db->open);
     assert(baton->db->handle);
     assert(baton->db->pending == 0);
-    int status = uv_queue_work(uv_default_loop(),
-        &baton->request, Work_Exec, (uv_after_work_cb)Work_AfterExec);
-    assert(status == 0);
+    baton->db->QueueWork(&baton->request,
+        Work_Exec, (uv_after_work_cb)Work_AfterExec);
 }
 
 void Database::Work_Exec(uv_work_t* req) {
     ExecBaton* baton = static_cast<ExecBaton*>(req->data);
+    Database* db = baton->db;
+
+    sqlite3_mutex* mtx = sqlite3_db_mutex(db->handle);
+    sqlite3_mutex_enter(mtx);
 
     char* message = NULL;
     baton->status = sqlite3_exec(
-        baton->db->handle,
+        db->handle,
         baton->sql.c_str(),
         NULL,
         NULL,
@@ -521,6 +1496,9 @@ void Database::Work_Exec(uv_work_t* req) {
         baton->message = std::string(message);
         sqlite3_free(message);
     }
+
+    db->UpdateCommitted();
+    db->LeaveConnection(mtx);
 }
 
 void Database::Work_AfterExec(uv_work_t* req) {
@@ -599,9 +1577,8 @@ void Database::Work_BeginLoadExtension(Baton* baton) {
     assert(baton->db->open);
     assert(baton->db->handle);
     assert(baton->db->pending == 0);
-    int status = uv_queue_work(uv_default_loop(),
-        &baton->request, Work_LoadExtension, (uv_after_work_cb)Work_AfterLoadExtension);
-    assert(status == 0);
+    baton->db->QueueWork(&baton->request,
+        Work_LoadExtension, (uv_after_work_cb)Work_AfterLoadExtension);
 }
 
 void Database::Work_LoadExtension(uv_work_t* req) {
@@ -652,13 +1629,276 @@ void Database::Work_AfterLoadExtension(uv_work_t* req) {
     delete baton;
 }
 
+// Database#registerFunction(name, options, fn, [callback])
+Handle<Value> Database::RegisterFunction(const Arguments& args) {
+    HandleScope scope;
+    Database* db = ObjectWrap::Unwrap<Database>(args.This());
+
+    REQUIRE_ARGUMENT_STRING(0, name);
+    if (args.Length() <= 1 || !args[1]->IsObject()) {
+        return ThrowException(Exception::TypeError(
+            String::New("Argument 1 must be an object")));
+    }
+    REQUIRE_ARGUMENT_FUNCTION(2, function);
+    OPTIONAL_ARGUMENT_FUNCTION(3, callback);
+
+    Local<Object> options = args[1]->ToObject();
+    bool deterministic = options->Get(String::NewSymbol("deterministic"))->BooleanValue();
+    bool aggregate = options->Get(String::NewSymbol("aggregate"))->BooleanValue();
+
+    Baton* baton = new FunctionBaton(db, callback, *name, function,
+        deterministic, aggregate);
+    db->Schedule(Work_RegisterFunction, baton, true);
+
+    return args.This();
+}
+
+// Runs while no other work is in progress, so the connections are idle.
+void Database::Work_RegisterFunction(Baton* b) {
+    HandleScope scope;
+    FunctionBaton* baton = static_cast<FunctionBaton*>(b);
+    Database* db = baton->db;
+
+    assert(db->locked);
+    assert(db->open);
+    assert(db->pending == 0);
+
+    if (db->bridge == NULL) {
+        db->bridge = new FunctionBridge();
+    }
+    UserFunction* function = new UserFunction(db, db->bridge, baton->function,
+        baton->deterministic, baton->aggregate);
+    db->functions.push_back(function);
+
+    baton->status = function->Create(db->handle, baton->name.c_str());
+    for (unsigned int i = 0; baton->status == SQLITE_OK && i < db->readers.size(); i++) {
+        baton->status = function->Create(db->readers[i], baton->name.c_str());
+    }
+
+    if (baton->status != SQLITE_OK) {
+        EXCEPTION(String::New(sqlite3_errmsg(db->handle)), baton->status, exception);
+
+        if (!baton->callback.IsEmpty() && baton->callback->IsFunction()) {
+            Local<Value> argv[] = { exception };
+            TRY_CATCH_CALL(db->handle_, baton->callback, 1, argv);
+        }
+        else {
+            Local<Value> args[] = { String::NewSymbol("error"), exception };
+            EMIT_EVENT(db->handle_, 2, args);
+        }
+    }
+    else if (!baton->callback.IsEmpty() && baton->callback->IsFunction()) {
+        Local<Value> argv[] = { Local<Value>::New(Null()) };
+        TRY_CATCH_CALL(db->handle_, baton->callback, 1, argv);
+    }
+
+    db->Process();
+
+    delete baton;
+}
+
+// Must only be called once the connections are closed.
+void Database::RemoveFunctions() {
+    for (unsigned int i = 0; i < functions.size(); i++) {
+        delete functions[i];
+    }
+    functions.clear();
+    if (bridge) {
+        bridge->Close();
+        bridge = NULL;
+    }
+}
+
+// Returns the least loaded reader, or -1 if there are none, and counts one
+// more query running on it. Workers pick readers while holding the mutex of
+// the primary connection, so that concurrent picks see each other's counts.
+int Database::AcquireReader() {
+    int reader = -1;
+    for (unsigned int i = 0; i < readers.size(); i++) {
+        if (reader < 0 || reader_load[i] < reader_load[reader]) {
+            reader = i;
+        }
+    }
+    if (reader >= 0) {
+        NODE_SQLITE3_ATOMIC_ADD(&reader_load[reader], 1)
+    }
+    return reader;
+}
+
+void Database::ReleaseReader(int reader) {
+    assert(reader >= 0 && reader_load[reader] > 0);
+    NODE_SQLITE3_ATOMIC_SUB(&reader_load[reader], 1)
+}
+
+// Database#backup(filename, pagesPerStep, sleepMs, [progress], [callback])
+Handle<Value> Database::Backup(const Arguments& args) {
+    HandleScope scope;
+    Database* db = ObjectWrap::Unwrap<Database>(args.This());
+
+    REQUIRE_ARGUMENT_STRING(0, filename);
+    OPTIONAL_ARGUMENT_INTEGER(1, pages, 100);
+    OPTIONAL_ARGUMENT_INTEGER(2, sleep, 10);
+    OPTIONAL_ARGUMENT_FUNCTION(3, progress);
+    OPTIONAL_ARGUMENT_FUNCTION(4, callback);
+
+    if (pages == 0 || sleep < 0) {
+        return ThrowException(Exception::RangeError(
+            String::New("pagesPerStep must not be 0 and sleepMs must not be negative"))
+        );
+    }
+
+    Baton* baton = new BackupBaton(db, callback, *filename, pages, sleep, progress);
+    db->Schedule(Work_BeginBackup, baton);
+
+    return args.This();
+}
+
+void Database::Work_BeginBackup(Baton* baton) {
+    assert(baton->db->open);
+    assert(baton->db->handle);
+
+    BackupBaton* backup = static_cast<BackupBaton*>(baton);
+    if (backup->timer == NULL) {
+        backup->db->backups++;
+        backup->timer = new uv_timer_t;
+        uv_timer_init(uv_default_loop(), backup->timer);
+        backup->timer->data = backup;
+    }
+
+    baton->db->pending++;
+    baton->db->QueueWork(&baton->request,
+        Work_Backup, (uv_after_work_cb)Work_AfterBackup);
+}
+
+void Database::Work_Backup(uv_work_t* req) {
+    BackupBaton* baton = static_cast<BackupBaton*>(req->data);
+    Database* db = baton->db;
+
+    if (baton->backup == NULL) {
+        baton->status = sqlite3_open_v2(baton->filename.c_str(), &baton->dest,
+            SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
+        if (baton->status == SQLITE_OK) {
+            baton->backup = sqlite3_backup_init(baton->dest, "main", db->handle, "main");
+            if (baton->backup == NULL) {
+                baton->status = sqlite3_errcode(baton->dest);
+            }
+        }
+        if (baton->status != SQLITE_OK) {
+            baton->message = std::string(sqlite3_errmsg(baton->dest));
+            sqlite3_close(baton->dest);
+            baton->dest = NULL;
+            baton->finished = true;
+            return;
+        }
+    }
+
+    int status = sqlite3_backup_step(baton->backup, baton->pages);
+    baton->remaining = sqlite3_backup_remaining(baton->backup);
+    baton->pagecount = sqlite3_backup_pagecount(baton->backup);
+
+    if (status == SQLITE_OK || status == SQLITE_BUSY || status == SQLITE_LOCKED) {
+        // Try again after the delay.
+        return;
+    }
+
+    baton->finished = true;
+    sqlite3_backup_finish(baton->backup);
+    baton->backup = NULL;
+    baton->status = sqlite3_errcode(baton->dest);
+    if (baton->status != SQLITE_OK) {
+        baton->message = std::string(sqlite3_errmsg(baton->dest));
+    }
+    sqlite3_close(baton->dest);
+    baton->dest = NULL;
+}
+
+void Database::Work_AfterBackup(uv_work_t* req) {
+    HandleScope scope;
+    BackupBaton* baton = static_cast<BackupBaton*>(req->data);
+    Database* db = baton->db;
+
+    db->pending--;
+
+    if (baton->status == SQLITE_OK && baton->pagecount > 0 &&
+            !baton->progress.IsEmpty() && baton->progress->IsFunction()) {
+        Local<Value> argv[] = {
+            Integer::New(baton->remaining),
+            Integer::New(baton->pagecount)
+        };
+        TRY_CATCH_CALL(db->handle_, baton->progress, 2, argv);
+    }
+
+    if (!baton->finished) {
+        uv_timer_start(baton->timer, BackupTimeout, baton->sleep, 0);
+        db->Process();
+        return;
+    }
+
+    Local<Value> argv[1];
+    if (baton->status != SQLITE_OK) {
+        EXCEPTION(String::New(baton->message.c_str()), baton->status, exception);
+        argv[0] = exception;
+    }
+    else {
+        argv[0] = Local<Value>::New(Null());
+    }
+
+    if (!baton->callback.IsEmpty() && baton->callback->IsFunction()) {
+        TRY_CATCH_CALL(db->handle_, baton->callback, 1, argv);
+    }
+    else if (baton->status != SQLITE_OK) {
+        Local<Value> args[] = { String::NewSymbol("error"), argv[0] };
+        EMIT_EVENT(db->handle_, 2, args);
+    }
+
+    uv_close((uv_handle_t*)baton->timer, BackupTimerClosed);
+    db->backups--;
+    db->Process();
+
+    delete baton;
+}
+
+void Database::BackupTimeout(uv_timer_t* handle, int status) {
+    BackupBaton* baton = static_cast<BackupBaton*>(handle->data);
+    if (baton->db->locked && baton->db->pending > 0) {
+        // An exclusive call is running on the connection; try again later.
+        // Steps aren't queued with Schedule because a waiting close would
+        // keep them from running.
+        uv_timer_start(baton->timer, BackupTimeout, baton->sleep, 0);
+        return;
+    }
+    Work_BeginBackup(baton);
+}
+
+void Database::BackupTimerClosed(uv_handle_t* handle) {
+    delete (uv_timer_t*)handle;
+}
+
 void Database::RemoveCallbacks() {
     if (debug_trace) {
+        if (handle) SetTraceHook(false);
         debug_trace->finish();
         debug_trace = NULL;
     }
-    if (debug_profile) {
-        debug_profile->finish();
+    if (debug_profile || stats_enabled) {
+        AsyncProfile* profile = debug_profile;
         debug_profile = NULL;
+        stats_enabled = false;
+        SetProfileHook();
+        if (profile) profile->finish();
+    }
+    if (update_event) {
+        if (handle) {
+            ConnectionLock lock(bridge, handle);
+            sqlite3_update_hook(handle, NULL, NULL);
+            sqlite3_commit_hook(handle, NULL, NULL);
+            sqlite3_rollback_hook(handle, NULL, NULL);
+        }
+        delete update_batch;
+        update_batch = NULL;
+        delete update_committing;
+        update_committing = NULL;
+        update_event->finish();
+        update_event = NULL;
     }
 }
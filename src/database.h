@@ -5,9 +5,13 @@
 
 #include <string>
 #include <queue>
+#include <vector>
 
 #include <sqlite3.h>
 #include "async.h"
+#include "worker.h"
+#include "stats.h"
+#include "checkpoint.h"
 
 using namespace v8;
 using namespace node;
@@ -15,6 +19,10 @@ using namespace node;
 namespace node_sqlite3 {
 
 class Database;
+class Blob;
+class StatementCache;
+class FunctionBridge;
+struct UserFunction;
 
 
 class Database : public ObjectWrap {
@@ -50,8 +58,22 @@ public:
     struct OpenBaton : Baton {
         std::string filename;
         int mode;
+        int readers;
+        std::string journal_mode;
+        std::string synchronous;
+        // Log size in pages that triggers a background checkpoint; 0 keeps
+        // SQLite's automatic checkpoints.
+        int checkpoint_pages;
+        // Applied to every connection; -1 and 0 keep SQLite's defaults.
+        sqlite3_int64 mmap_size;
+        int cache_size;
+        bool immutable;
+        int lookaside_size;
+        int lookaside_count;
         OpenBaton(Database* db_, Handle<Function> cb_, const char* filename_, int mode_) :
-            Baton(db_, cb_), filename(filename_), mode(mode_) {}
+            Baton(db_, cb_), filename(filename_), mode(mode_), readers(0),
+            checkpoint_pages(0), mmap_size(-1), cache_size(0), immutable(false),
+            lookaside_size(-1), lookaside_count(-1) {}
     };
 
     struct ExecBaton : Baton {
@@ -60,12 +82,71 @@ public:
             Baton(db_, cb_), sql(sql_) {}
     };
 
+    struct GroupCommitBaton : Baton {
+        unsigned int generation;
+        GroupCommitBaton(Database* db_) :
+            Baton(db_, Handle<Function>()), generation(0) {}
+    };
+
+    // Copies the database to another file a number of pages at a time. The
+    // source connection is only locked while a step runs; between steps a
+    // timer waits for the configured delay.
+    struct BackupBaton : Baton {
+        std::string filename;
+        int pages;
+        int sleep;
+        sqlite3* dest;
+        sqlite3_backup* backup;
+        int remaining;
+        int pagecount;
+        bool finished;
+        uv_timer_t* timer;
+        Persistent<Function> progress;
+        BackupBaton(Database* db_, Handle<Function> cb_, const char* filename_,
+                int pages_, int sleep_, Handle<Function> progress_) :
+                Baton(db_, cb_), filename(filename_), pages(pages_),
+                sleep(sleep_), dest(NULL), backup(NULL), remaining(0),
+                pagecount(0), finished(false), timer(NULL) {
+            progress = Persistent<Function>::New(progress_);
+        }
+        virtual ~BackupBaton() {
+            progress.Dispose();
+        }
+    };
+
     struct LoadExtensionBaton : Baton {
         std::string filename;
         LoadExtensionBaton(Database* db_, Handle<Function> cb_, const char* filename_) :
             Baton(db_, cb_), filename(filename_) {}
     };
 
+    struct StatusBaton : Baton {
+        bool reset;
+        // Sums over the primary and the reader connections.
+        sqlite3_int64 values[SQLITE_DBSTATUS_MAX + 1];
+        sqlite3_int64 highwater;
+        StatusBaton(Database* db_, Handle<Function> cb_, bool reset_) :
+                Baton(db_, cb_), reset(reset_), highwater(0) {
+            for (int i = 0; i <= SQLITE_DBSTATUS_MAX; i++) values[i] = 0;
+        }
+    };
+
+    struct FunctionBaton : Baton {
+        std::string name;
+        Persistent<Function> function;
+        bool deterministic;
+        bool aggregate;
+        FunctionBaton(Database* db_, Handle<Function> cb_, const char* name_,
+                Handle<Function> function_, bool deterministic_, bool aggregate_) :
+                Baton(db_, cb_), name(name_), deterministic(deterministic_),
+                aggregate(aggregate_) {
+            function = Persistent<Function>::New(function_);
+        }
+        virtual ~FunctionBaton() {
+            function.Dispose();
+        }
+    };
+
     typedef void (*Work_Callback)(Baton* baton);
 
     struct Call {
@@ -88,43 +169,127 @@ public:
         sqlite3_int64 rowid;
     };
 
+    // The changes made by one transaction.
+    typedef std::vector<UpdateInfo> UpdateBatch;
+
+    // Buffering limits for Statement#each. A high water mark of 0 means
+    // that the worker never waits for the item callbacks.
+    struct EachLimits {
+        EachLimits() : high_water(0), high_water_bytes(0), low_water(0),
+            low_water_bytes(0), chunk_size(1) {}
+        unsigned int high_water;
+        size_t high_water_bytes;
+        unsigned int low_water;
+        size_t low_water_bytes;
+        unsigned int chunk_size;
+    };
+
+    // State of configure('groupCommit'). Writes on the primary connection
+    // that start while it is in autocommit mode join an implicit
+    // transaction. Each BEGIN starts a new generation; the callbacks of its
+    // writes are deferred until that generation was committed.
+    struct GroupCommit {
+        GroupCommit() : enabled(false), max_rows(1000), max_delay(10),
+            open(false), generation(0), writable_blobs(0), rows(0),
+            reported(0), committed(0),
+            committing(false), timing(false), timer(NULL) {}
+        bool enabled;
+        unsigned int max_rows;
+        unsigned int max_delay;
+
+        // Worker side; guarded by the mutex of the primary connection.
+        bool open;
+        unsigned int generation;
+        // An open writable blob keeps a COMMIT from succeeding, so no
+        // implicit transaction is started while there are any.
+        unsigned int writable_blobs;
+
+        // Main thread.
+        unsigned int rows;
+        unsigned int reported;
+        unsigned int committed;
+        bool committing;
+        bool timing;
+        uv_timer_t* timer;
+    };
+
+    struct GroupWrite {
+        Persistent<Object> stmt;
+        Persistent<Function> callback;
+        sqlite3_int64 inserted_id;
+        int changes;
+        unsigned int generation;
+    };
+
     bool IsOpen() { return open; }
     bool IsLocked() { return locked; }
+    // Whether synchronous calls have to wait: a worker running a user
+    // function waits for the main thread, and serialized calls run in order.
+    bool IsBusy() {
+        return locked || (bridge && pending) || !queue.empty() ||
+            (serialize && pending);
+    }
 
     typedef Async<std::string, Database> AsyncTrace;
     typedef Async<ProfileInfo, Database> AsyncProfile;
-    typedef Async<UpdateInfo, Database> AsyncUpdate;
+
+    // Data of the profile hook. It is replaced rather than modified while
+    // the mutex of every connection is held, so that a worker running the
+    // hook always sees a consistent and live set of receivers.
+    struct ProfileHook {
+        ProfileHook(AsyncProfile* profile_, QueryStats* stats_) :
+            profile(profile_), stats(stats_) {}
+        AsyncProfile* profile;
+        QueryStats* stats;
+    };
+    typedef Async<UpdateBatch, Database> AsyncUpdate;
 
     friend class Statement;
+    friend class Blob;
+    friend class StatementCache;
 
 protected:
     Database() : ObjectWrap(),
         handle(NULL),
         open(false),
         locked(false),
+        closing(false),
         pending(0),
+        backups(0),
         serialize(false),
+        pin_buffers(false),
+        pipeline(false),
+        worker(NULL),
+        statement_cache(NULL),
+        checkpointer(NULL),
+        bridge(NULL),
         debug_trace(NULL),
-        debug_profile(NULL) {
+        debug_profile(NULL),
+        update_event(NULL),
+        update_batch(NULL),
+        update_committing(NULL),
+        update_types(0),
+        update_filter(0),
+        stats(NULL),
+        stats_enabled(false),
+        profile_hook(NULL) {
 
     }
 
-    ~Database() {
-        RemoveCallbacks();
-        sqlite3_close(handle);
-        handle = NULL;
-        open = false;
-    }
+    ~Database();
 
     static Handle<Value> New(const Arguments& args);
     static void Work_BeginOpen(Baton* baton);
     static void Work_Open(uv_work_t* req);
     static void Work_AfterOpen(uv_work_t* req);
+    static int ConfigureConnection(sqlite3* connection, OpenBaton* baton);
+    static bool UsesWal(sqlite3* connection);
 
     static Handle<Value> OpenGetter(Local<String> str, const AccessorInfo& accessor);
 
     void Schedule(Work_Callback callback, Baton* baton, bool exclusive = false);
     void Process();
+    void QueueWork(uv_work_t* req, uv_work_cb work, uv_after_work_cb after);
 
     static Handle<Value> Exec(const Arguments& args);
     static void Work_BeginExec(Baton* baton);
@@ -139,46 +304,147 @@ protected:
     static void Work_Close(uv_work_t* req);
     static void Work_AfterClose(uv_work_t* req);
 
+    static Handle<Value> Backup(const Arguments& args);
+    static void Work_BeginBackup(Baton* baton);
+    static void Work_Backup(uv_work_t* req);
+    static void Work_AfterBackup(uv_work_t* req);
+    static void BackupTimeout(uv_timer_t* handle, int status);
+    static void BackupTimerClosed(uv_handle_t* handle);
+
     static Handle<Value> LoadExtension(const Arguments& args);
     static void Work_BeginLoadExtension(Baton* baton);
     static void Work_LoadExtension(uv_work_t* req);
     static void Work_AfterLoadExtension(uv_work_t* req);
 
+    static Handle<Value> Interrupt(const Arguments& args);
+    static Handle<Value> Stats(const Arguments& args);
+
+    static Handle<Value> Status(const Arguments& args);
+    static void Work_BeginStatus(Baton* baton);
+    static void Work_Status(uv_work_t* req);
+    static void Work_AfterStatus(uv_work_t* req);
+
+    static Handle<Value> RegisterFunction(const Arguments& args);
+    static void Work_RegisterFunction(Baton* baton);
+    void RemoveFunctions();
+
     static Handle<Value> Serialize(const Arguments& args);
     static Handle<Value> Parallelize(const Arguments& args);
 
     static Handle<Value> Configure(const Arguments& args);
+    static Handle<Value> StatementCacheStats(const Arguments& args);
+    static Handle<Value> CheckpointStats(const Arguments& args);
 
     static void SetBusyTimeout(Baton* baton);
 
+    unsigned int GroupJoin(sqlite3_stmt* stmt);
+    int GroupCommitWork(unsigned int& generation, std::string& message);
+    void GroupDefer(Handle<Object> stmt, Handle<Function> callback,
+        sqlite3_int64 inserted_id, int changes, unsigned int generation);
+    void GroupCommitted(unsigned int generation, int status, const std::string& message);
+    void GroupFlush();
+    void GroupArm();
+    bool NeedsGroupCommit(Work_Callback callback);
+    inline bool GroupDirty() { return group.reported > group.committed; }
+    static void GroupTimeout(uv_timer_t* handle, int status);
+    static void GroupTimerClosed(uv_handle_t* handle);
+    static void Work_GroupCommit(uv_work_t* req);
+    static void Work_AfterGroupCommit(uv_work_t* req);
+
     static void RegisterTraceCallback(Baton* baton);
     static void TraceCallback(void* db, const char* sql);
     static void TraceCallback(Database* db, std::string* sql);
+    void SetTraceHook(bool enabled);
 
     static void RegisterProfileCallback(Baton* baton);
-    static void ProfileCallback(void* db, const char* sql, sqlite3_uint64 nsecs);
+    static void ProfileCallback(void* hook, const char* sql, sqlite3_uint64 nsecs);
     static void ProfileCallback(Database* db, ProfileInfo* info);
+    static void RegisterStats(Baton* baton);
+    void SetProfileHook();
 
     static void RegisterUpdateCallback(Baton* baton);
     static void UpdateCallback(void* db, int type, const char* database, const char* table, sqlite3_int64 rowid);
-    static void UpdateCallback(Database* db, UpdateInfo* info);
+    static int CommitCallback(void* db);
+    static void RollbackCallback(void* db);
+    static void UpdateCallback(Database* db, UpdateBatch* batch);
+    void UpdateCommitted();
+    size_t UpdateMark() { return update_batch ? update_batch->size() : 0; }
+    void UpdateUndo(size_t mark);
 
     void RemoveCallbacks();
 
+    int AcquireReader();
+    void ReleaseReader(int reader);
+    void LeaveConnection(sqlite3_mutex* mtx);
+
 protected:
     sqlite3* handle;
 
+    // Additional read-only connections to the same file. Each execution of
+    // a query runs on the reader with the fewest running queries so that
+    // they can step in parallel to each other and to the primary connection.
+    std::vector<sqlite3*> readers;
+    // Running queries per reader; changed atomically.
+    std::vector<unsigned long> reader_load;
+
     bool open;
     bool locked;
+    // Set while the handles are being closed on the worker.
+    bool closing;
     unsigned int pending;
+    // Running backups; closing waits for them to finish.
+    unsigned int backups;
+    // Open blobs; closing closes them first.
+    std::vector<Blob*> blobs;
 
     bool serialize;
+    bool pin_buffers;
+    bool pipeline;
+    EachLimits each_limits;
+
+    GroupCommit group;
+    std::vector<GroupWrite*> group_writes;
 
     std::queue<Call*> queue;
 
+    // Runs this database's work when it was opened with the thread option;
+    // NULL when it uses the libuv threadpool.
+    Worker* worker;
+
+    // Prepared statements of the convenience methods that are kept for
+    // reuse. Created when the statementCache option is configured.
+    StatementCache* statement_cache;
+
+    // Checkpoints the write-ahead log when the database was opened with the
+    // checkpoint option.
+    Checkpointer* checkpointer;
+
+    // User functions and the bridge their calls take to the main thread.
+    // Both are created by the first registerFunction call and stay until
+    // the connections are closed.
+    FunctionBridge* bridge;
+    std::vector<UserFunction*> functions;
+
     AsyncTrace* debug_trace;
     AsyncProfile* debug_profile;
     AsyncUpdate* update_event;
+    // Changes of the open transaction, and those of the transaction whose
+    // COMMIT is running. Only used on the worker that holds the mutex of
+    // the primary connection.
+    UpdateBatch* update_batch;
+    UpdateBatch* update_committing;
+    // Bits (1 << type) of the change events that have listeners.
+    unsigned int update_types;
+    // Copy of update_types for the hook, only changed while the mutex of
+    // the primary connection is held.
+    unsigned int update_filter;
+
+    // Latency histograms of the stats option. Kept until the database is
+    // destroyed so that they can be read after disabling it.
+    QueryStats* stats;
+    bool stats_enabled;
+    // Installed on all connections; only replaced by SetProfileHook.
+    ProfileHook* profile_hook;
 };
 
 }
@@ -0,0 +1,429 @@
+#include <string.h>
+#include <node.h>
+#include <node_buffer.h>
+#include <node_version.h>
+
+#include "macros.h"
+#include "database.h"
+#include "function.h"
+
+using namespace node_sqlite3;
+
+static Values::Field* FieldFromValue(sqlite3_value* value) {
+    const unsigned short pos = 1;
+    switch (sqlite3_value_type(value)) {
+        case SQLITE_INTEGER: {
+            return new Values::Integer(pos, sqlite3_value_int64(value));
+        }
+        case SQLITE_FLOAT: {
+            return new Values::Float(pos, sqlite3_value_double(value));
+        }
+        case SQLITE_TEXT: {
+            const char* text = (const char*)sqlite3_value_text(value);
+            return new Values::Text(pos, sqlite3_value_bytes(value), text);
+        }
+        case SQLITE_BLOB: {
+            const void* blob = sqlite3_value_blob(value);
+            return new Values::Blob(pos, sqlite3_value_bytes(value), blob);
+        }
+        default: {
+            return new Values::Null(pos);
+        }
+    }
+}
+
+static Values::Field* FieldFromJS(Local<Value> source) {
+    const unsigned short pos = 1;
+    if (source->IsString()) {
+        String::Utf8Value val(source->ToString());
+        return new Values::Text(pos, val.length(), *val);
+    }
+    else if (source->IsInt32()) {
+        return new Values::Integer(pos, source->Int32Value());
+    }
+    else if (source->IsNumber() || source->IsDate()) {
+        return new Values::Float(pos, source->NumberValue());
+    }
+    else if (source->IsBoolean()) {
+        return new Values::Integer(pos, source->BooleanValue() ? 1 : 0);
+    }
+    else if (source->IsNull() || source->IsUndefined()) {
+        return new Values::Null(pos);
+    }
+    else if (Buffer::HasInstance(source)) {
+        Local<Object> buffer = source->ToObject();
+        return new Values::Blob(pos, Buffer::Length(buffer), Buffer::Data(buffer));
+    }
+    return NULL;
+}
+
+static Local<Value> FieldToJS(Values::Field* field) {
+    switch (field->type) {
+        case SQLITE_INTEGER: {
+            return Local<Value>(Number::New(((Values::Integer*)field)->value));
+        }
+        case SQLITE_FLOAT: {
+            return Local<Value>(Number::New(((Values::Float*)field)->value));
+        }
+        case SQLITE_TEXT: {
+            const std::string& text = ((Values::Text*)field)->value;
+            return Local<Value>(String::New(text.data(), text.size()));
+        }
+        case SQLITE_BLOB: {
+            Values::Blob* blob = (Values::Blob*)field;
+#if NODE_VERSION_AT_LEAST(0, 11, 3)
+            return Local<Value>::New(Buffer::New(blob->value, blob->length));
+#else
+            return Local<Value>::New(Buffer::New(blob->value, blob->length)->handle_);
+#endif
+        }
+        default: {
+            return Local<Value>::New(Null());
+        }
+    }
+}
+
+static void SetResult(sqlite3_context* context, Values::Field* field) {
+    switch (field->type) {
+        case SQLITE_INTEGER: {
+            sqlite3_result_int64(context, ((Values::Integer*)field)->value);
+        } break;
+        case SQLITE_FLOAT: {
+            sqlite3_result_double(context, ((Values::Float*)field)->value);
+        } break;
+        case SQLITE_TEXT: {
+            const std::string& text = ((Values::Text*)field)->value;
+            sqlite3_result_text(context, text.data(), text.size(), SQLITE_TRANSIENT);
+        } break;
+        case SQLITE_BLOB: {
+            Values::Blob* blob = (Values::Blob*)field;
+            sqlite3_result_blob(context, blob->value, blob->length, SQLITE_TRANSIENT);
+        } break;
+        default: {
+            sqlite3_result_null(context);
+        } break;
+    }
+}
+
+// Appends a representation of the value that differs for any two values
+// that are not identical, including their type.
+static void Encode(std::string& key, Values::Field* field) {
+    key += (char)field->type;
+    switch (field->type) {
+        case SQLITE_INTEGER: {
+            int64_t value = ((Values::Integer*)field)->value;
+            key.append((const char*)&value, sizeof(value));
+        } break;
+        case SQLITE_FLOAT: {
+            double value = ((Values::Float*)field)->value;
+            key.append((const char*)&value, sizeof(value));
+        } break;
+        case SQLITE_TEXT: {
+            const std::string& text = ((Values::Text*)field)->value;
+            size_t length = text.size();
+            key.append((const char*)&length, sizeof(length));
+            key.append(text);
+        } break;
+        case SQLITE_BLOB: {
+            Values::Blob* blob = (Values::Blob*)field;
+            size_t length = blob->length;
+            key.append((const char*)&length, sizeof(length));
+            key.append(blob->value, length);
+        } break;
+    }
+}
+
+static void FillRow(Parameters& row, int argc, sqlite3_value** argv) {
+    row.reserve(argc);
+    for (int i = 0; i < argc; i++) {
+        row.push_back(FieldFromValue(argv[i]));
+    }
+}
+
+UserFunction::UserFunction(Database* db_, FunctionBridge* bridge_,
+        Handle<Function> fn, bool deterministic_, bool aggregate_) :
+        db(db_), bridge(bridge_), deterministic(deterministic_),
+        aggregate(aggregate_) {
+    callback = Persistent<Function>::New(fn);
+    NODE_SQLITE3_MUTEX_INIT
+}
+
+UserFunction::~UserFunction() {
+    Results::iterator it = results.begin();
+    for (; it != results.end(); ++it) {
+        DELETE_FIELD(it->second.value);
+    }
+    callback.Dispose();
+    NODE_SQLITE3_MUTEX_DESTROY
+}
+
+int UserFunction::Create(sqlite3* connection, const char* name) {
+    if (aggregate) {
+        return sqlite3_create_function(connection, name, -1, SQLITE_UTF8,
+            this, NULL, Step, Final);
+    }
+    return sqlite3_create_function(connection, name, -1, SQLITE_UTF8,
+        this, Scalar, NULL, NULL);
+}
+
+void UserFunction::Scalar(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    UserFunction* function = static_cast<UserFunction*>(sqlite3_user_data(context));
+
+    FunctionCall call(function);
+    call.rows.resize(1);
+    FillRow(call.rows[0], argc, argv);
+
+    std::string key;
+    if (function->deterministic) {
+        for (int i = 0; i < argc; i++) {
+            Encode(key, call.rows[0][i]);
+        }
+
+        bool found = false;
+        NODE_SQLITE3_MUTEX_LOCK(&function->mutex)
+        Results::iterator it = function->results.find(key);
+        if (it != function->results.end()) {
+            SetResult(context, it->second.value);
+            function->uses.splice(function->uses.begin(), function->uses,
+                it->second.use);
+            found = true;
+        }
+        NODE_SQLITE3_MUTEX_UNLOCK(&function->mutex)
+        if (found) return;
+    }
+
+    function->bridge->Call(&call);
+
+    if (!call.error.empty()) {
+        sqlite3_result_error(context, call.error.c_str(), -1);
+        return;
+    }
+
+    SetResult(context, call.result);
+
+    if (function->deterministic) {
+        NODE_SQLITE3_MUTEX_LOCK(&function->mutex)
+        // Another connection may have stored the same result meanwhile.
+        Result result = { call.result, function->uses.end() };
+        std::pair<Results::iterator, bool> stored =
+            function->results.insert(std::make_pair(key, result));
+        if (stored.second) {
+            call.result = NULL;
+            function->uses.push_front(key);
+            stored.first->second.use = function->uses.begin();
+            if (function->results.size() > max_results) {
+                Results::iterator oldest = function->results.find(function->uses.back());
+                DELETE_FIELD(oldest->second.value);
+                function->results.erase(oldest);
+                function->uses.pop_back();
+            }
+        }
+        NODE_SQLITE3_MUTEX_UNLOCK(&function->mutex)
+    }
+}
+
+// Aggregates don't need a result before the group ends, so the arguments are
+// only collected here and handed to JavaScript in one call by Final.
+void UserFunction::Step(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    std::vector<Parameters>** rows = static_cast<std::vector<Parameters>**>(
+        sqlite3_aggregate_context(context, sizeof(std::vector<Parameters>*)));
+    if (rows == NULL) {
+        sqlite3_result_error_nomem(context);
+        return;
+    }
+
+    if (*rows == NULL) {
+        *rows = new std::vector<Parameters>();
+    }
+    (*rows)->push_back(Parameters());
+    FillRow((*rows)->back(), argc, argv);
+}
+
+void UserFunction::Final(sqlite3_context* context) {
+    UserFunction* function = static_cast<UserFunction*>(sqlite3_user_data(context));
+    std::vector<Parameters>** rows = static_cast<std::vector<Parameters>**>(
+        sqlite3_aggregate_context(context, 0));
+
+    FunctionCall call(function);
+    if (rows != NULL && *rows != NULL) {
+        call.rows.swap(**rows);
+        delete *rows;
+        *rows = NULL;
+    }
+
+    function->bridge->Call(&call);
+
+    if (!call.error.empty()) {
+        sqlite3_result_error(context, call.error.c_str(), -1);
+    }
+    else {
+        SetResult(context, call.result);
+    }
+}
+
+FunctionCall::FunctionCall(UserFunction* function_) :
+        function(function_), result(NULL), done(false) {
+    NODE_SQLITE3_MUTEX_INIT
+    NODE_SQLITE3_COND_INIT
+}
+
+FunctionCall::~FunctionCall() {
+    for (unsigned int i = 0; i < rows.size(); i++) {
+        for (unsigned int j = 0; j < rows[i].size(); j++) {
+            DELETE_FIELD(rows[i][j]);
+        }
+    }
+    DELETE_FIELD(result);
+    NODE_SQLITE3_MUTEX_DESTROY
+    NODE_SQLITE3_COND_DESTROY
+}
+
+FunctionBridge::FunctionBridge() : main_thread(uv_thread_self()), waiting(false) {
+    watcher.data = this;
+    NODE_SQLITE3_MUTEX_INIT
+    NODE_SQLITE3_COND_INIT
+    uv_async_init(uv_default_loop(), &watcher, Listener);
+    // Workers waiting for a call keep the loop alive through their request.
+#if NODE_VERSION_AT_LEAST(0, 7, 9)
+    uv_unref((uv_handle_t *)&watcher);
+#else
+    uv_unref(uv_default_loop());
+#endif
+}
+
+FunctionBridge::~FunctionBridge() {
+    NODE_SQLITE3_COND_DESTROY
+    NODE_SQLITE3_MUTEX_DESTROY
+}
+
+void FunctionBridge::Call(FunctionCall* call) {
+    if (uv_thread_self() == main_thread) {
+        // Called from a synchronous statement method.
+        Run(call);
+        return;
+    }
+
+    NODE_SQLITE3_MUTEX_LOCK(&mutex)
+    calls.push_back(call);
+    if (waiting) {
+        NODE_SQLITE3_COND_SIGNAL(&cond)
+    }
+    NODE_SQLITE3_MUTEX_UNLOCK(&mutex)
+    uv_async_send(&watcher);
+
+    NODE_SQLITE3_MUTEX_LOCK(&call->mutex)
+    while (!call->done) {
+        NODE_SQLITE3_COND_WAIT(&call->cond, &call->mutex)
+    }
+    NODE_SQLITE3_MUTEX_UNLOCK(&call->mutex)
+}
+
+void FunctionBridge::Drain() {
+    std::vector<FunctionCall*> batch;
+    NODE_SQLITE3_MUTEX_LOCK(&mutex)
+    batch.swap(calls);
+    NODE_SQLITE3_MUTEX_UNLOCK(&mutex)
+
+    for (unsigned int i = 0; i < batch.size(); i++) {
+        FunctionCall* call = batch[i];
+        Run(call);
+        NODE_SQLITE3_MUTEX_LOCK(&call->mutex)
+        call->done = true;
+        NODE_SQLITE3_COND_SIGNAL(&call->cond)
+        NODE_SQLITE3_MUTEX_UNLOCK(&call->mutex)
+    }
+}
+
+// The mutex of the connection is tried while the bridge's own is held, so
+// that a worker releasing it or queuing a call can't slip in between the
+// try and the wait.
+bool FunctionBridge::Wait(sqlite3_mutex* connection) {
+    NODE_SQLITE3_MUTEX_LOCK(&mutex)
+    bool acquired = sqlite3_mutex_try(connection) == SQLITE_OK;
+    if (!acquired && calls.empty()) {
+        waiting = true;
+        // SQLite also holds the mutex inside calls that don't go through
+        // Database::LeaveConnection, such as backup steps; those don't
+        // signal, so the wait is bounded.
+        NODE_SQLITE3_COND_TIMEDWAIT(&cond, &mutex, 10)
+        waiting = false;
+    }
+    NODE_SQLITE3_MUTEX_UNLOCK(&mutex)
+    return acquired;
+}
+
+// Called by a worker after it released the mutex of a connection.
+void FunctionBridge::Released() {
+    NODE_SQLITE3_MUTEX_LOCK(&mutex)
+    if (waiting) {
+        NODE_SQLITE3_COND_SIGNAL(&cond)
+    }
+    NODE_SQLITE3_MUTEX_UNLOCK(&mutex)
+}
+
+void FunctionBridge::Run(FunctionCall* call) {
+    HandleScope scope;
+    UserFunction* function = call->function;
+
+    std::vector<Local<Value> > argv;
+    if (function->aggregate) {
+        Local<Array> rows = Array::New(call->rows.size());
+        for (unsigned int i = 0; i < call->rows.size(); i++) {
+            Parameters& row = call->rows[i];
+            Local<Array> args = Array::New(row.size());
+            for (unsigned int j = 0; j < row.size(); j++) {
+                args->Set(j, FieldToJS(row[j]));
+            }
+            rows->Set(i, args);
+        }
+        argv.push_back(rows);
+    }
+    else {
+        Parameters& row = call->rows[0];
+        for (unsigned int j = 0; j < row.size(); j++) {
+            argv.push_back(FieldToJS(row[j]));
+        }
+    }
+
+    TryCatch try_catch;
+    Local<Value> result = function->callback->Call(function->db->handle_,
+        argv.size(), argv.empty() ? NULL : &argv[0]);
+
+    if (try_catch.HasCaught()) {
+        String::Utf8Value message(try_catch.Exception()->ToString());
+        call->error = *message ? *message : "Function failed";
+    }
+    else {
+        call->result = FieldFromJS(result);
+        if (call->result == NULL) {
+            call->error = "Function returned an unsupported type";
+        }
+    }
+}
+
+void FunctionBridge::Listener(uv_async_t* handle, int status) {
+    static_cast<FunctionBridge*>(handle->data)->Drain();
+}
+
+void FunctionBridge::Close() {
+    uv_close((uv_handle_t*)&watcher, Closed);
+}
+
+void FunctionBridge::Closed(uv_handle_t* handle) {
+    delete static_cast<FunctionBridge*>(handle->data);
+}
+
+ConnectionLock::ConnectionLock(FunctionBridge* bridge, sqlite3* connection) :
+        mutex(sqlite3_db_mutex(connection)) {
+    if (bridge == NULL) {
+        sqlite3_mutex_enter(mutex);
+        return;
+    }
+    while (!bridge->Wait(mutex)) {
+        bridge->Drain();
+    }
+}
+
+ConnectionLock::~ConnectionLock() {
+    sqlite3_mutex_leave(mutex);
+}
@@ -0,0 +1,124 @@
+#ifndef NODE_SQLITE3_SRC_FUNCTION_H
+#define NODE_SQLITE3_SRC_FUNCTION_H
+
+#include <node.h>
+
+#include "statement.h"
+#include "threading.h"
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <sqlite3.h>
+
+using namespace v8;
+using namespace node;
+
+namespace node_sqlite3 {
+
+class Database;
+class FunctionBridge;
+
+// A JavaScript function registered with Database#registerFunction. SQLite
+// calls it on the worker threads; the arguments are copied and the call is
+// run on the main thread through the database's FunctionBridge. Scalar
+// functions need their result before the row can be stepped further, so
+// each call is one round trip while the worker holds the connection.
+struct UserFunction {
+    UserFunction(Database* db_, FunctionBridge* bridge_, Handle<Function> fn,
+        bool deterministic_, bool aggregate_);
+    ~UserFunction();
+
+    static void Scalar(sqlite3_context* context, int argc, sqlite3_value** argv);
+    static void Step(sqlite3_context* context, int argc, sqlite3_value** argv);
+    static void Final(sqlite3_context* context);
+
+    int Create(sqlite3* connection, const char* name);
+
+    // Remembered results of a deterministic function; the least recently
+    // used one is dropped when there are more.
+    static const size_t max_results = 10000;
+
+    Database* db;
+    FunctionBridge* bridge;
+    Persistent<Function> callback;
+    bool deterministic;
+    bool aggregate;
+
+    // Results by encoded argument values, with the keys in the order of
+    // their last use, most recent first. Shared by all connections.
+    struct Result {
+        Values::Field* value;
+        std::list<std::string>::iterator use;
+    };
+    typedef std::map<std::string, Result> Results;
+    NODE_SQLITE3_MUTEX_t
+    Results results;
+    std::list<std::string> uses;
+};
+
+// One invocation of a user function. Scalar functions pass one argument
+// list; aggregates pass the argument lists of their whole group at once.
+struct FunctionCall {
+    FunctionCall(UserFunction* function_);
+    ~FunctionCall();
+
+    UserFunction* function;
+    std::vector<Parameters> rows;
+    Values::Field* result;
+    std::string error;
+
+    bool done;
+    NODE_SQLITE3_MUTEX_t
+    NODE_SQLITE3_COND_t
+};
+
+// Hands calls from the workers to the main thread. Every wake-up runs all
+// calls that were queued by then, so queries stepping in parallel share one
+// trip through the event loop. The calling worker blocks until its call ran.
+class FunctionBridge {
+public:
+    FunctionBridge();
+
+    void Call(FunctionCall* call);
+    // Runs the queued calls. Must be called on the main thread.
+    void Drain();
+    // Takes the mutex of a connection on the main thread, or waits until a
+    // call was queued or a worker released a connection.
+    bool Wait(sqlite3_mutex* connection);
+    void Released();
+    void Close();
+
+protected:
+    ~FunctionBridge();
+
+    static void Run(FunctionCall* call);
+    static void Listener(uv_async_t* handle, int status);
+    static void Closed(uv_handle_t* handle);
+
+    uv_async_t watcher;
+    unsigned long main_thread;
+    NODE_SQLITE3_MUTEX_t
+    NODE_SQLITE3_COND_t
+    std::vector<FunctionCall*> calls;
+    // Set while the main thread waits in Wait.
+    bool waiting;
+};
+
+// Holds the mutex of a connection on the main thread. While a worker holds
+// it, queued function calls are run in the meantime: that worker may be
+// waiting for one and would otherwise never give the mutex up.
+class ConnectionLock {
+public:
+    ConnectionLock(FunctionBridge* bridge, sqlite3* connection);
+    ~ConnectionLock();
+
+private:
+    sqlite3_mutex* mutex;
+};
+
+}
+
+#endif
@@ -4,6 +4,9 @@
 const char* sqlite_code_string(int code);
 const char* sqlite_authorizer_string(int type);
 
+// Not an SQLite result code: reported when a call runs past its timeoutMs.
+#define NODE_SQLITE3_TIMEOUT 0x1000
+
 
 #define REQUIRE_ARGUMENTS(n)                                                   \
     if (args.Length() < (n)) {                                                 \
@@ -135,9 +138,8 @@ const char* sqlite_authorizer_string(int type);
     assert(baton->stmt->prepared);                                             \
     baton->stmt->locked = true;                                                \
     baton->stmt->db->pending++;                                                \
-    int status = uv_queue_work(uv_default_loop(),                              \
-        &baton->request, Work_##type, (uv_after_work_cb)Work_After##type);                       \
-    assert(status == 0);
+    baton->stmt->db->QueueWork(&baton->request,                               \
+        Work_##type, (uv_after_work_cb)Work_After##type);
 
 #define STATEMENT_INIT(type)                                                   \
     type* baton = static_cast<type*>(req->data);                               \
@@ -146,10 +148,12 @@ const char* sqlite_authorizer_string(int type);
 #define STATEMENT_END()                                                        \
     assert(stmt->locked);                                                      \
     assert(stmt->db->pending);                                                 \
-    stmt->locked = false;                                                      \
-    stmt->db->pending--;                                                       \
-    stmt->Process();                                                           \
-    stmt->db->Process();                                                       \
+    if (!stmt->pipelined) {                                                    \
+        stmt->locked = false;                                                  \
+        stmt->db->pending--;                                                   \
+        stmt->Process();                                                       \
+        stmt->db->Process();                                                   \
+    }                                                                          \
     delete baton;
 
 #define DELETE_FIELD(field)                                                    \
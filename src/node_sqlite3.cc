@@ -2,6 +2,7 @@
 #include <node_buffer.h>
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <sstream>
 #include <cstring>
 #include <string>
@@ -10,14 +11,130 @@
 #include "macros.h"
 #include "database.h"
 #include "statement.h"
+#include "blob.h"
+#include "allocator.h"
 
 using namespace node_sqlite3;
 
 namespace {
 
+// Slots of SQLITE_CONFIG_PAGECACHE; SQLite uses them until the process exits.
+void* page_cache = NULL;
+
+// sqlite3.configure(options)
+// Process-wide settings of SQLite. They must be made before the first
+// database is opened, which initializes SQLite.
+// Bytes that each page cache slot needs besides the page itself.
+static int PageHeaderSize() {
+#ifdef SQLITE_CONFIG_PCACHE_HDRSZ
+    int size = 0;
+    if (sqlite3_config(SQLITE_CONFIG_PCACHE_HDRSZ, &size) == SQLITE_OK) {
+        return size;
+    }
+#endif
+    // SQLite only reports it since 3.8.8. For the bundled 3.7.17 this is
+    // what it would report: the b-tree, pager and page cache headers, each
+    // rounded up to 8 bytes.
+    return sizeof(void*) == 8 ? 248 : 152;
+}
+
+Handle<Value> Configure(const Arguments& args) {
+    HandleScope scope;
+
+    if (args.Length() < 1 || !args[0]->IsObject()) {
+        return ThrowException(Exception::TypeError(
+            String::New("Argument 0 must be an object"))
+        );
+    }
+    Local<Object> options = args[0]->ToObject();
+
+    bool pool = false;
+    if (options->Has(String::NewSymbol("allocator"))) {
+        GET_STRING(options, allocator, "allocator");
+        pool = strcmp(*allocator, "pool") == 0;
+        if (!pool && strcmp(*allocator, "system") != 0) {
+            return ThrowException(Exception::TypeError(
+                String::New("allocator must be pool or system"))
+            );
+        }
+    }
+
+    int page_size = 0, pages = 0;
+    if (options->Has(String::NewSymbol("pageCache"))) {
+        Local<Value> value = options->Get(String::NewSymbol("pageCache"));
+        if (value->IsObject()) {
+            GET_INTEGER(value->ToObject(), size, "pageSize");
+            GET_INTEGER(value->ToObject(), count, "pages");
+            page_size = size;
+            pages = count;
+        }
+        if (page_size < 512 || page_size > 65536 || (page_size & (page_size - 1)) || pages <= 0) {
+            return ThrowException(Exception::TypeError(
+                String::New("pageCache needs a pageSize that is a power of two from 512 to 65536 and a positive number of pages"))
+            );
+        }
+    }
+
+    int lookaside_size = -1, lookaside_count = -1;
+    if (options->Has(String::NewSymbol("lookaside"))) {
+        Local<Value> value = options->Get(String::NewSymbol("lookaside"));
+        if (value->IsObject()) {
+            GET_INTEGER(value->ToObject(), size, "size");
+            GET_INTEGER(value->ToObject(), count, "count");
+            lookaside_size = size;
+            lookaside_count = count;
+        }
+        if (lookaside_size < 0 || lookaside_count < 0) {
+            return ThrowException(Exception::TypeError(
+                String::New("lookaside needs a non-negative size and count"))
+            );
+        }
+    }
+
+    int status = SQLITE_OK;
+    if (options->Has(String::NewSymbol("memstatus"))) {
+        // Memory statistics take a global mutex on every allocation.
+        status = sqlite3_config(SQLITE_CONFIG_MEMSTATUS,
+            (int)options->Get(String::NewSymbol("memstatus"))->BooleanValue());
+    }
+    if (status == SQLITE_OK && pool) {
+        status = sqlite3_config(SQLITE_CONFIG_MALLOC, &PoolAllocator::methods);
+    }
+    if (status == SQLITE_OK && pages > 0) {
+        // Each slot also holds the headers of its page.
+        int slot = page_size + PageHeaderSize();
+        void* slab = malloc((size_t)slot * pages);
+        status = slab ? sqlite3_config(SQLITE_CONFIG_PAGECACHE, slab, slot, pages) : SQLITE_NOMEM;
+        if (status == SQLITE_OK) {
+            free(page_cache);
+            page_cache = slab;
+        }
+        else {
+            free(slab);
+        }
+    }
+    if (status == SQLITE_OK && lookaside_size >= 0) {
+        status = sqlite3_config(SQLITE_CONFIG_LOOKASIDE, lookaside_size, lookaside_count);
+    }
+
+    if (status == SQLITE_MISUSE) {
+        EXCEPTION(String::New("SQLite is already initialized; configure must be called before opening a database"), status, exception);
+        return ThrowException(exception);
+    }
+    else if (status != SQLITE_OK) {
+        EXCEPTION(String::New("Invalid configuration"), status, exception);
+        return ThrowException(exception);
+    }
+
+    return Undefined();
+}
+
 void RegisterModule(v8::Handle<Object> target) {
     Database::Init(target);
     Statement::Init(target);
+    Blob::Init(target);
+
+    NODE_SET_METHOD(target, "configure", Configure);
 
     DEFINE_CONSTANT_INTEGER(target, SQLITE_OPEN_READONLY, OPEN_READONLY);
     DEFINE_CONSTANT_INTEGER(target, SQLITE_OPEN_READWRITE, OPEN_READWRITE);
@@ -55,6 +172,7 @@ void RegisterModule(v8::Handle<Object> target) {
     DEFINE_CONSTANT_INTEGER(target, SQLITE_FORMAT, FORMAT);
     DEFINE_CONSTANT_INTEGER(target, SQLITE_RANGE, RANGE);
     DEFINE_CONSTANT_INTEGER(target, SQLITE_NOTADB, NOTADB);
+    DEFINE_CONSTANT_INTEGER(target, NODE_SQLITE3_TIMEOUT, TIMEOUT);
 }
 
 }
@@ -90,6 +208,7 @@ const char* sqlite_code_string(int code) {
         case SQLITE_NOTADB:     return "SQLITE_NOTADB";
         case SQLITE_ROW:        return "SQLITE_ROW";
         case SQLITE_DONE:       return "SQLITE_DONE";
+        case NODE_SQLITE3_TIMEOUT: return "SQLITE_TIMEOUT";
         default:                return "UNKNOWN";
     }
 }
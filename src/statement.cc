@@ -1,4 +1,5 @@
 #include <string.h>
+#include <ctype.h>
 #include <node.h>
 #include <node_buffer.h>
 #include <node_version.h>
@@ -6,6 +7,7 @@
 #include "macros.h"
 #include "database.h"
 #include "statement.h"
+#include "function.h"
 
 using namespace node_sqlite3;
 
@@ -23,9 +25,16 @@ void Statement::Init(Handle<Object> target) {
     NODE_SET_PROTOTYPE_METHOD(constructor_template, "bind", Bind);
     NODE_SET_PROTOTYPE_METHOD(constructor_template, "get", Get);
     NODE_SET_PROTOTYPE_METHOD(constructor_template, "run", Run);
+    NODE_SET_PROTOTYPE_METHOD(constructor_template, "runBatch", RunBatch);
+    NODE_SET_PROTOTYPE_METHOD(constructor_template, "runColumns", RunColumns);
     NODE_SET_PROTOTYPE_METHOD(constructor_template, "all", All);
     NODE_SET_PROTOTYPE_METHOD(constructor_template, "each", Each);
+    NODE_SET_PROTOTYPE_METHOD(constructor_template, "fetch", Fetch);
     NODE_SET_PROTOTYPE_METHOD(constructor_template, "reset", Reset);
+    NODE_SET_PROTOTYPE_METHOD(constructor_template, "getSync", GetSync);
+    NODE_SET_PROTOTYPE_METHOD(constructor_template, "runSync", RunSync);
+    NODE_SET_PROTOTYPE_METHOD(constructor_template, "allSync", AllSync);
+    NODE_SET_PROTOTYPE_METHOD(constructor_template, "status", Status);
     NODE_SET_PROTOTYPE_METHOD(constructor_template, "finalize", Finalize);
 
     target->Set(String::NewSymbol("Statement"),
@@ -41,11 +50,64 @@ void Statement::Process() {
         Call* call = queue.front();
         queue.pop();
 
+        if (db->pipeline && !queue.empty() && Pipeline(call)) {
+            continue;
+        }
+
         call->callback(call->baton);
         delete call;
     }
 }
 
+// Starts a pipeline with call and the calls that follow it in the queue.
+// Returns false when the call was not started because there aren't at
+// least two consecutive calls that can be pipelined.
+bool Statement::Pipeline(Call* call) {
+    PipelineBaton::Item first, next;
+    if (!PipelineItem(call, first) || !PipelineItem(queue.front(), next)) {
+        return false;
+    }
+
+    PipelineBaton* baton = new PipelineBaton(this);
+    baton->items.push_back(first);
+    delete call;
+
+    while (!queue.empty() && PipelineItem(queue.front(), next)) {
+        baton->items.push_back(next);
+        delete queue.front();
+        queue.pop();
+    }
+
+    Work_BeginPipeline(baton);
+    return true;
+}
+
+bool Statement::PipelineItem(Call* call, PipelineBaton::Item& item) {
+    if (call->callback == Work_BeginBind) {
+        item.work = Work_Bind;
+        item.after = Work_AfterBind;
+    }
+    else if (call->callback == Work_BeginGet) {
+        item.work = Work_Get;
+        item.after = Work_AfterGet;
+    }
+    else if (call->callback == Work_BeginRun) {
+        item.work = Work_Run;
+        item.after = Work_AfterRun;
+    }
+    else if (call->callback == Work_BeginReset) {
+        item.work = Work_Reset;
+        item.after = Work_AfterReset;
+    }
+    else {
+        return false;
+    }
+
+    item.baton = call->baton;
+    item.status = SQLITE_OK;
+    return true;
+}
+
 void Statement::Schedule(Work_Callback callback, Baton* baton) {
     if (finalized) {
         queue.push(new Call(callback, baton));
@@ -75,7 +137,7 @@ template <class T> void Statement::Error(T* baton) {
     }
 }
 
-// { Database db, String sql, Array params, Function callback }
+// { Database db, String sql, Function callback, Object options }
 Handle<Value> Statement::New(const Arguments& args) {
     HandleScope scope;
 
@@ -110,6 +172,52 @@ Handle<Value> Statement::New(const Arguments& args) {
 
     PrepareBaton* baton = new PrepareBaton(db, Local<Function>::Cast(args[2]), stmt);
     baton->sql = std::string(*String::Utf8Value(sql));
+
+    bool cache = false, sync = false;
+    if (length > 3 && args[3]->IsObject()) {
+        Local<Object> options = args[3]->ToObject();
+        cache = options->Get(String::NewSymbol("cache"))->BooleanValue();
+        sync = options->Get(String::NewSymbol("sync"))->BooleanValue();
+    }
+
+    if (sync) {
+        // Prepare on the primary connection right away, unless that would
+        // overtake queued or serialized calls or wait for a worker.
+        sqlite3_mutex* mtx = NULL;
+        if (db->open && !db->IsBusy()) {
+            mtx = sqlite3_db_mutex(db->handle);
+            if (sqlite3_mutex_try(mtx) != SQLITE_OK) mtx = NULL;
+        }
+        if (mtx == NULL) {
+            delete baton;
+            EXCEPTION(String::New(db->open ? "Database is busy" : "Database is closed"),
+                SQLITE_MISUSE, exception);
+            return ThrowException(exception);
+        }
+
+        Work_Prepare(&baton->request);
+        sqlite3_mutex_leave(mtx);
+        if (stmt->status != SQLITE_OK) {
+            EXCEPTION(String::New(stmt->message.c_str()), stmt->status, exception);
+            stmt->Finalize();
+            delete baton;
+            return ThrowException(exception);
+        }
+
+        stmt->prepared = true;
+        stmt->locked = false;
+        stmt->SetColumns(baton->columns);
+        delete baton;
+        return args.This();
+    }
+
+    // Used by the Database convenience methods, which finalize the statement
+    // right after running it.
+    if (cache && db->statement_cache && db->statement_cache->Capacity()) {
+        stmt->cached = true;
+        stmt->sql = baton->sql;
+    }
+
     db->Schedule(Work_BeginPrepare, baton);
 
     return args.This();
@@ -118,45 +226,182 @@ Handle<Value> Statement::New(const Arguments& args) {
 void Statement::Work_BeginPrepare(Database::Baton* baton) {
     assert(baton->db->open);
     baton->db->pending++;
-    int status = uv_queue_work(uv_default_loop(),
-        &baton->request, Work_Prepare, (uv_after_work_cb)Work_AfterPrepare);
-    assert(status == 0);
+
+    PrepareBaton* prepare = static_cast<PrepareBaton*>(baton);
+    Statement* stmt = prepare->stmt;
+    if (stmt->cached) {
+        StatementCache::Entry* entry = baton->db->statement_cache->Acquire(prepare->sql);
+        if (entry != NULL) {
+            // Skip the trip to the thread pool.
+            stmt->handle = entry->handle;
+            stmt->connection = sqlite3_db_handle(entry->handle);
+            stmt->reader = entry->reader;
+            stmt->query = entry->query;
+            stmt->columns = entry->columns;
+            prepare->columns = new Columns(entry->columns);
+            delete entry;
+            Work_AfterPrepare(&baton->request);
+            return;
+        }
+    }
+
+    prepare->reader = baton->db->AcquireReader();
+    baton->db->QueueWork(&baton->request,
+        Work_Prepare, (uv_after_work_cb)Work_AfterPrepare);
 }
 
 void Statement::Work_Prepare(uv_work_t* req) {
     STATEMENT_INIT(PrepareBaton);
+    Database* db = baton->db;
+
+    // Queries are prepared on a reader and moved to the connection that
+    // runs them on every execution (see Route). Statements that a reader
+    // can't prepare (e.g. on temporary tables) or that could modify the
+    // database or connection state stay on the primary.
+    if (baton->reader >= 0) {
+        stmt->connection = db->readers[baton->reader];
+        stmt->reader = baton->reader;
+        stmt->query = true;
+        if (!stmt->Prepare(baton->sql) || !stmt->IsQuery()) {
+            sqlite3_finalize(stmt->handle);
+            stmt->handle = NULL;
+            stmt->reader = -1;
+            stmt->query = false;
+        }
+    }
+
+    if (stmt->reader < 0) {
+        stmt->connection = db->handle;
+        stmt->Prepare(baton->sql);
+    }
 
+    if (stmt->status == SQLITE_OK) {
+        baton->columns = stmt->UpdateColumns();
+    }
+}
+
+bool Statement::Prepare(const std::string& sql) {
     // In case preparing fails, we use a mutex to make sure we get the associated
     // error message.
-    sqlite3_mutex* mtx = sqlite3_db_mutex(baton->db->handle);
+    sqlite3_mutex* mtx = sqlite3_db_mutex(connection);
     sqlite3_mutex_enter(mtx);
 
-    stmt->status = sqlite3_prepare_v2(
-        baton->db->handle,
-        baton->sql.c_str(),
-        baton->sql.size(),
-        &stmt->handle,
+    status = sqlite3_prepare_v2(
+        connection,
+        sql.c_str(),
+        sql.size(),
+        &handle,
         NULL
     );
 
-    if (stmt->status != SQLITE_OK) {
-        stmt->message = std::string(sqlite3_errmsg(baton->db->handle));
-        stmt->handle = NULL;
+    if (status != SQLITE_OK) {
+        message = std::string(sqlite3_errmsg(connection));
+        handle = NULL;
     }
 
-    sqlite3_mutex_leave(mtx);
+    db->LeaveConnection(mtx);
+    return status == SQLITE_OK;
+}
+
+bool Statement::IsQuery() {
+    if (!sqlite3_stmt_readonly(handle) || sqlite3_column_count(handle) == 0) {
+        return false;
+    }
+    // Pragmas are read-only but may return rows while changing settings of
+    // the connection they run on.
+    const char* sql = sqlite3_sql(handle);
+    while (isspace(*sql)) sql++;
+    return sqlite3_strnicmp(sql, "PRAGMA", 6) != 0;
+}
+
+// Called on the worker before an execution steps the statement. A query
+// runs on the primary connection while a transaction is open there, whose
+// uncommitted changes only it can see, and otherwise on the reader with the
+// fewest running queries. It is only moved when the execution resets it and
+// either replaces its bindings or it has no parameters; otherwise it stays
+// where its cursor and bindings are. Returns the reader whose load was
+// counted for the execution, or -1.
+int Statement::Route(bool resets, bool rebinds) {
+    if (!query || pinned) {
+        return -1;
+    }
+
+    if (!resets || (!rebinds && sqlite3_bind_parameter_count(handle) > 0)) {
+        if (reader >= 0) {
+            NODE_SQLITE3_ATOMIC_ADD(&db->reader_load[reader], 1)
+        }
+        return reader;
+    }
+
+    sqlite3_mutex* mtx = sqlite3_db_mutex(db->handle);
+    sqlite3_mutex_enter(mtx);
+    int target = -1;
+    if (sqlite3_get_autocommit(db->handle)) {
+        target = db->AcquireReader();
+    }
+    db->LeaveConnection(mtx);
+
+    if (target != reader && !Move(target)) {
+        // Stay on the current connection.
+        if (target >= 0) db->ReleaseReader(target);
+        if (reader >= 0) {
+            NODE_SQLITE3_ATOMIC_ADD(&db->reader_load[reader], 1)
+        }
+        return reader;
+    }
+    return target;
+}
+
+// Makes the handle on the target connection current, preparing it there if
+// necessary, and keeps the previous one idle.
+bool Statement::Move(int target) {
+    if (idle.empty()) {
+        NODE_SQLITE3_MUTEX_LOCK(&mutex)
+        idle.assign(db->readers.size() + 1, NULL);
+        NODE_SQLITE3_MUTEX_UNLOCK(&mutex)
+    }
+
+    sqlite3* next_connection = target >= 0 ? db->readers[target] : db->handle;
+    sqlite3_stmt* next = idle[target + 1];
+    if (next == NULL) {
+        sqlite3_mutex* mtx = sqlite3_db_mutex(next_connection);
+        sqlite3_mutex_enter(mtx);
+        int result = sqlite3_prepare_v2(next_connection, sqlite3_sql(handle), -1, &next, NULL);
+        db->LeaveConnection(mtx);
+        if (result != SQLITE_OK) {
+            // The readers can't see temporary tables of the primary.
+            if (target >= 0) query = false;
+            return false;
+        }
+    }
+
+    sqlite3_reset(handle);
+    sqlite3_clear_bindings(handle);
+    NODE_SQLITE3_MUTEX_LOCK(&mutex)
+    idle[reader + 1] = handle;
+    idle[target + 1] = NULL;
+    handle = next;
+    connection = next_connection;
+    reader = target;
+    NODE_SQLITE3_MUTEX_UNLOCK(&mutex)
+    return true;
 }
 
 void Statement::Work_AfterPrepare(uv_work_t* req) {
     HandleScope scope;
     STATEMENT_INIT(PrepareBaton);
 
+    if (baton->reader >= 0) {
+        baton->db->ReleaseReader(baton->reader);
+    }
+
     if (stmt->status != SQLITE_OK) {
         Error(baton);
         stmt->Finalize();
     }
     else {
         stmt->prepared = true;
+        stmt->SetColumns(baton->columns);
         if (!baton->callback.IsEmpty() && baton->callback->IsFunction()) {
             Local<Value> argv[] = { Local<Value>::New(Null()) };
             TRY_CATCH_CALL(stmt->handle_, baton->callback, 1, argv);
@@ -167,7 +412,7 @@ void Statement::Work_AfterPrepare(uv_work_t* req) {
 }
 
 template <class T> Values::Field*
-                   Statement::BindParameter(const Handle<Value> source, T pos) {
+                   Statement::BindParameter(const Handle<Value> source, T pos, Baton* baton) {
     if (source->IsString() || source->IsRegExp()) {
         String::Utf8Value val(source->ToString());
         return new Values::Text(pos, val.length(), *val);
@@ -186,6 +431,11 @@ template <class T> Values::Field*
     }
     else if (Buffer::HasInstance(source)) {
         Local<Object> buffer = source->ToObject();
+        if (db->pin_buffers) {
+            // Keep the Buffer alive for as long as SQLite may read from it.
+            baton->pins.push_back(Persistent<Object>::New(buffer));
+            return new Values::Blob(pos, Buffer::Length(buffer), Buffer::Data(buffer), true);
+        }
         return new Values::Blob(pos, Buffer::Length(buffer), Buffer::Data(buffer));
     }
     else if (source->IsDate()) {
@@ -196,6 +446,38 @@ template <class T> Values::Field*
     }
 }
 
+void Statement::BindSet(const Local<Value> source, Parameters& parameters, Baton* baton) {
+    if (source->IsArray()) {
+        Local<Array> array = Local<Array>::Cast(source);
+        int length = array->Length();
+        // Note: bind parameters start with 1.
+        for (int i = 0, pos = 1; i < length; i++, pos++) {
+            parameters.push_back(BindParameter(array->Get(i), pos, baton));
+        }
+    }
+    else if (!source->IsObject() || source->IsRegExp() || source->IsDate() || Buffer::HasInstance(source)) {
+        // A single parameter.
+        parameters.push_back(BindParameter(source, 1, baton));
+    }
+    else {
+        Local<Object> object = source->ToObject();
+        Local<Array> array = object->GetPropertyNames();
+        int length = array->Length();
+        for (int i = 0; i < length; i++) {
+            Local<Value> name = array->Get(i);
+
+            if (name->IsInt32()) {
+                parameters.push_back(
+                    BindParameter(object->Get(name), name->Int32Value(), baton));
+            }
+            else {
+                parameters.push_back(BindParameter(object->Get(name),
+                    *String::Utf8Value(Local<String>::Cast(name)), baton));
+            }
+        }
+    }
+}
+
 template <class T> T* Statement::Bind(const Arguments& args, int start, int last) {
     if (last < 0) last = args.Length();
     Local<Function> callback;
@@ -204,43 +486,38 @@ template <class T> T* Statement::Bind(const Arguments& args, int start, int last
         last--;
     }
 
+    // An options object after the parameters. Without parameters before it,
+    // it must hold nothing but options; an object that mixes them with
+    // named parameters is bound as parameters, and the unknown name then
+    // fails with SQLITE_RANGE instead of the parameters being dropped.
+    double timeout = 0;
+    if (last > start && args[last - 1]->IsObject() && !args[last - 1]->IsArray() &&
+            !args[last - 1]->IsRegExp() && !args[last - 1]->IsDate() &&
+            !Buffer::HasInstance(args[last - 1])) {
+        Local<Object> options = args[last - 1]->ToObject();
+        Local<String> timeoutMs = String::NewSymbol("timeoutMs");
+        if (options->Has(timeoutMs) &&
+                (last - 1 > start || options->GetPropertyNames()->Length() == 1)) {
+            timeout = options->Get(timeoutMs)->NumberValue();
+            last--;
+        }
+    }
+
     T* baton = new T(this, callback);
+    if (timeout > 0) {
+        baton->deadline = uv_hrtime() + (uint64_t)(timeout * 1e6);
+    }
 
     if (start < last) {
-        if (args[start]->IsArray()) {
-            Local<Array> array = Local<Array>::Cast(args[start]);
-            int length = array->Length();
-            // Note: bind parameters start with 1.
-            for (int i = 0, pos = 1; i < length; i++, pos++) {
-                baton->parameters.push_back(BindParameter(array->Get(i), pos));
-            }
-        }
-        else if (!args[start]->IsObject() || args[start]->IsRegExp() || args[start]->IsDate() || Buffer::HasInstance(args[start])) {
+        if (!args[start]->IsArray() && (!args[start]->IsObject() || args[start]->IsRegExp() || args[start]->IsDate() || Buffer::HasInstance(args[start]))) {
             // Parameters directly in array.
             // Note: bind parameters start with 1.
             for (int i = start, pos = 1; i < last; i++, pos++) {
-                baton->parameters.push_back(BindParameter(args[i], pos));
-            }
-        }
-        else if (args[start]->IsObject()) {
-            Local<Object> object = Local<Object>::Cast(args[start]);
-            Local<Array> array = object->GetPropertyNames();
-            int length = array->Length();
-            for (int i = 0; i < length; i++) {
-                Local<Value> name = array->Get(i);
-
-                if (name->IsInt32()) {
-                    baton->parameters.push_back(
-                        BindParameter(object->Get(name), name->Int32Value()));
-                }
-                else {
-                    baton->parameters.push_back(BindParameter(object->Get(name),
-                        *String::Utf8Value(Local<String>::Cast(name))));
-                }
+                baton->parameters.push_back(BindParameter(args[i], pos, baton));
             }
         }
         else {
-            return NULL;
+            BindSet(args[start], baton->parameters, baton);
         }
     }
 
@@ -269,34 +546,11 @@ bool Statement::Bind(const Parameters parameters) {
             else {
                 pos = sqlite3_bind_parameter_index(handle, field->name.c_str());
             }
-
-            switch (field->type) {
-                case SQLITE_INTEGER: {
-                    status = sqlite3_bind_int(handle, pos,
-                        ((Values::Integer*)field)->value);
-                } break;
-                case SQLITE_FLOAT: {
-                    status = sqlite3_bind_double(handle, pos,
-                        ((Values::Float*)field)->value);
-                } break;
-                case SQLITE_TEXT: {
-                    status = sqlite3_bind_text(handle, pos,
-                        ((Values::Text*)field)->value.c_str(),
-                        ((Values::Text*)field)->value.size(), SQLITE_TRANSIENT);
-                } break;
-                case SQLITE_BLOB: {
-                    status = sqlite3_bind_blob(handle, pos,
-                        ((Values::Blob*)field)->value,
-                        ((Values::Blob*)field)->length, SQLITE_TRANSIENT);
-                } break;
-                case SQLITE_NULL: {
-                    status = sqlite3_bind_null(handle, pos);
-                } break;
-            }
+            status = BindValue(pos, field);
         }
 
         if (status != SQLITE_OK) {
-            message = std::string(sqlite3_errmsg(db->handle));
+            message = std::string(sqlite3_errmsg(connection));
             return false;
         }
     }
@@ -304,6 +558,139 @@ bool Statement::Bind(const Parameters parameters) {
     return true;
 }
 
+int Statement::BindValue(int pos, Values::Field* field) {
+    switch (field->type) {
+        case SQLITE_INTEGER: {
+            return sqlite3_bind_int(handle, pos,
+                ((Values::Integer*)field)->value);
+        }
+        case SQLITE_FLOAT: {
+            return sqlite3_bind_double(handle, pos,
+                ((Values::Float*)field)->value);
+        }
+        case SQLITE_TEXT: {
+            return sqlite3_bind_text(handle, pos,
+                ((Values::Text*)field)->value.c_str(),
+                ((Values::Text*)field)->value.size(), SQLITE_TRANSIENT);
+        }
+        case SQLITE_BLOB: {
+            Values::Blob* blob = (Values::Blob*)field;
+            return sqlite3_bind_blob(handle, pos, blob->value, blob->length,
+                blob->pinned ? SQLITE_STATIC : SQLITE_TRANSIENT);
+        }
+        default: {
+            return sqlite3_bind_null(handle, pos);
+        }
+    }
+}
+
+// Binds the element of the given row of a runColumns column.
+int Statement::BindColumn(const Column& column, size_t row) {
+    if (column.data == NULL) {
+        return BindValue(column.index, column.values[row]);
+    }
+
+    sqlite3_int64 value;
+    switch (column.type) {
+        case kExternalFloatArray:
+            return sqlite3_bind_double(handle, column.index, ((float*)column.data)[row]);
+        case kExternalDoubleArray:
+            return sqlite3_bind_double(handle, column.index, ((double*)column.data)[row]);
+        case kExternalByteArray:
+            value = ((int8_t*)column.data)[row]; break;
+        case kExternalShortArray:
+            value = ((int16_t*)column.data)[row]; break;
+        case kExternalUnsignedShortArray:
+            value = ((uint16_t*)column.data)[row]; break;
+        case kExternalIntArray:
+            value = ((int32_t*)column.data)[row]; break;
+        case kExternalUnsignedIntArray:
+            value = ((uint32_t*)column.data)[row]; break;
+        default:
+            value = ((uint8_t*)column.data)[row]; break;
+    }
+    return sqlite3_bind_int64(handle, column.index, value);
+}
+
+// Runs on the worker every few VM instructions while a call with a timeout
+// steps. A non-zero return makes sqlite3_step fail with SQLITE_INTERRUPT.
+int Statement::TimeoutHandler(void* data) {
+    Baton* baton = static_cast<Baton*>(data);
+    if (uv_hrtime() >= baton->deadline) {
+        baton->timed_out = true;
+        return 1;
+    }
+    return 0;
+}
+
+// Called on the worker with the mutex of the connection held, before a call
+// that doesn't join the implicit transaction of group commit steps the
+// statement. Writes and transaction statements must not run inside it:
+// their results would be reported before anything is committed, and a
+// failing COMMIT of the group would silently drop them.
+void Statement::GroupCommitBefore(Baton* baton) {
+    if (db->group.open && connection == db->handle &&
+            (!sqlite3_stmt_readonly(handle) || sqlite3_column_count(handle) == 0)) {
+        baton->commit_status = db->GroupCommitWork(baton->committed,
+            baton->commit_message);
+    }
+}
+
+// Fires the callbacks of the implicit transaction that GroupCommitBefore
+// finished, ahead of the callback of the call itself.
+void Statement::GroupCommitReport(Baton* baton) {
+    if (baton->committed) {
+        db->GroupCommitted(baton->committed, baton->commit_status,
+            baton->commit_message);
+    }
+}
+
+// Finishes a call that stepped rows on the main thread. The worker records
+// the columns of the rows it stepped only once per shape, so they are taken
+// over even if no callback looks at the rows.
+void Statement::ReportRows(Baton* baton) {
+    GroupCommitReport(baton);
+    SetColumns(baton->columns);
+}
+
+// Called on the worker before it releases the mutex of the connection.
+// Hands the changes of a transaction that the call committed on the primary
+// connection to the update events.
+void Statement::Committed() {
+    if (connection == db->handle) {
+        db->UpdateCommitted();
+    }
+}
+
+// Changes are only recorded for the primary connection, whose mutex the
+// worker holds when it runs the statement there.
+size_t Statement::UpdateMark() {
+    return connection == db->handle ? db->UpdateMark() : 0;
+}
+
+void Statement::UpdateUndo(size_t mark) {
+    if (connection == db->handle) {
+        db->UpdateUndo(mark);
+    }
+}
+
+// Both need the connection mutex to be held, so that the handler only ever
+// sees the steps of this call.
+void Statement::BeginTimeout(Baton* baton) {
+    if (baton->deadline) {
+        sqlite3_progress_handler(connection, 1000, TimeoutHandler, baton);
+    }
+}
+
+void Statement::EndTimeout(Baton* baton) {
+    if (!baton->deadline) return;
+    sqlite3_progress_handler(connection, 0, NULL, NULL);
+    if (baton->timed_out && status == SQLITE_INTERRUPT) {
+        status = NODE_SQLITE3_TIMEOUT;
+        message = "Query exceeded its time budget";
+    }
+}
+
 Handle<Value> Statement::Bind(const Arguments& args) {
     HandleScope scope;
     Statement* stmt = ObjectWrap::Unwrap<Statement>(args.This());
@@ -325,10 +712,10 @@ void Statement::Work_BeginBind(Baton* baton) {
 void Statement::Work_Bind(uv_work_t* req) {
     STATEMENT_INIT(Baton);
 
-    sqlite3_mutex* mtx = sqlite3_db_mutex(stmt->db->handle);
+    sqlite3_mutex* mtx = sqlite3_db_mutex(stmt->connection);
     sqlite3_mutex_enter(mtx);
     stmt->Bind(baton->parameters);
-    sqlite3_mutex_leave(mtx);
+    stmt->db->LeaveConnection(mtx);
 }
 
 void Statement::Work_AfterBind(uv_work_t* req) {
@@ -373,23 +760,33 @@ void Statement::Work_Get(uv_work_t* req) {
     STATEMENT_INIT(RowBaton);
 
     if (stmt->status != SQLITE_DONE || baton->parameters.size()) {
-        sqlite3_mutex* mtx = sqlite3_db_mutex(stmt->db->handle);
+        // Only parameters reset the cursor.
+        int load = stmt->Route(baton->parameters.size() > 0, true);
+        sqlite3_mutex* mtx = sqlite3_db_mutex(stmt->connection);
         sqlite3_mutex_enter(mtx);
 
         if (stmt->Bind(baton->parameters)) {
+            stmt->GroupCommitBefore(baton);
+            stmt->BeginTimeout(baton);
             stmt->status = sqlite3_step(stmt->handle);
 
-            if (!(stmt->status == SQLITE_ROW || stmt->status == SQLITE_DONE)) {
-                stmt->message = std::string(sqlite3_errmsg(stmt->db->handle));
+            if (stmt->status == SQLITE_ROW) {
+                baton->columns = stmt->UpdateColumns();
             }
+            else if (stmt->status != SQLITE_DONE) {
+                stmt->message = std::string(sqlite3_errmsg(stmt->connection));
+            }
+            stmt->EndTimeout(baton);
         }
 
-        sqlite3_mutex_leave(mtx);
+        stmt->Committed();
+        stmt->db->LeaveConnection(mtx);
 
         if (stmt->status == SQLITE_ROW) {
             // Acquire one result row before returning.
-            GetRow(&baton->row, stmt->handle);
+            baton->row.Append(stmt->handle);
         }
+        if (load >= 0) stmt->db->ReleaseReader(load);
     }
 }
 
@@ -397,6 +794,8 @@ void Statement::Work_AfterGet(uv_work_t* req) {
     HandleScope scope;
     STATEMENT_INIT(RowBaton);
 
+    stmt->ReportRows(baton);
+
     if (stmt->status != SQLITE_ROW && stmt->status != SQLITE_DONE) {
         Error(baton);
     }
@@ -405,7 +804,7 @@ void Statement::Work_AfterGet(uv_work_t* req) {
         if (!baton->callback.IsEmpty() && baton->callback->IsFunction()) {
             if (stmt->status == SQLITE_ROW) {
                 // Create the result array from the data we acquired.
-                Local<Value> argv[] = { Local<Value>::New(Null()), RowToJS(&baton->row) };
+                Local<Value> argv[] = { Local<Value>::New(Null()), stmt->RowToJS(baton->row, 0) };
                 TRY_CATCH_CALL(stmt->handle_, baton->callback, 2, argv);
             }
             else {
@@ -439,7 +838,8 @@ void Statement::Work_BeginRun(Baton* baton) {
 void Statement::Work_Run(uv_work_t* req) {
     STATEMENT_INIT(RunBaton);
 
-    sqlite3_mutex* mtx = sqlite3_db_mutex(stmt->db->handle);
+    int load = stmt->Route(true, baton->parameters.size() > 0);
+    sqlite3_mutex* mtx = sqlite3_db_mutex(stmt->connection);
     sqlite3_mutex_enter(mtx);
 
     // Make sure that we also reset when there are no parameters.
@@ -448,27 +848,70 @@ void Statement::Work_Run(uv_work_t* req) {
     }
 
     if (stmt->Bind(baton->parameters)) {
+        Database* db = stmt->db;
+        if (baton->deadline) {
+            // Interrupting a write rolls back the whole transaction, so
+            // calls with a timeout don't join the implicit one.
+            stmt->GroupCommitBefore(baton);
+        }
+        else {
+            if (db->group.open && stmt->connection == db->handle &&
+                    sqlite3_stmt_readonly(stmt->handle) &&
+                    sqlite3_column_count(stmt->handle) == 0) {
+                // Commit the implicit transaction before the application
+                // begins or ends a transaction of its own.
+                baton->commit_status = db->GroupCommitWork(baton->committed,
+                    baton->commit_message);
+            }
+            baton->generation = db->GroupJoin(stmt->handle);
+        }
+
+        stmt->BeginTimeout(baton);
+        size_t mark = stmt->UpdateMark();
         stmt->status = sqlite3_step(stmt->handle);
 
         if (!(stmt->status == SQLITE_ROW || stmt->status == SQLITE_DONE)) {
-            stmt->message = std::string(sqlite3_errmsg(stmt->db->handle));
+            stmt->message = std::string(sqlite3_errmsg(stmt->connection));
+            stmt->UpdateUndo(mark);
+            if (baton->generation && sqlite3_get_autocommit(db->handle)) {
+                // The error rolled back the implicit transaction.
+                db->group.open = false;
+                baton->committed = baton->generation;
+                baton->commit_status = stmt->status;
+                baton->commit_message = stmt->message;
+            }
         }
         else {
-            baton->inserted_id = sqlite3_last_insert_rowid(stmt->db->handle);
-            baton->changes = sqlite3_changes(stmt->db->handle);
+            baton->inserted_id = sqlite3_last_insert_rowid(stmt->connection);
+            baton->changes = sqlite3_changes(stmt->connection);
         }
+        stmt->EndTimeout(baton);
     }
 
-    sqlite3_mutex_leave(mtx);
+    stmt->Committed();
+    stmt->db->LeaveConnection(mtx);
+    if (load >= 0) stmt->db->ReleaseReader(load);
 }
 
 void Statement::Work_AfterRun(uv_work_t* req) {
     HandleScope scope;
     STATEMENT_INIT(RunBaton);
 
+    stmt->GroupCommitReport(baton);
+
     if (stmt->status != SQLITE_ROW && stmt->status != SQLITE_DONE) {
+        if (baton->generation && !baton->committed) {
+            // The implicit transaction is still open and needs a commit.
+            stmt->db->GroupDefer(stmt->handle_, Handle<Function>(),
+                0, 0, baton->generation);
+        }
         Error(baton);
     }
+    else if (baton->generation) {
+        // Fire the callback once the implicit transaction is committed.
+        stmt->db->GroupDefer(stmt->handle_, baton->callback,
+            baton->inserted_id, baton->changes, baton->generation);
+    }
     else {
         // Fire callbacks.
         if (!baton->callback.IsEmpty() && baton->callback->IsFunction()) {
@@ -483,128 +926,516 @@ void Statement::Work_AfterRun(uv_work_t* req) {
     STATEMENT_END();
 }
 
-Handle<Value> Statement::All(const Arguments& args) {
+// Statement#runBatch(sets, [options], [callback])
+Handle<Value> Statement::RunBatch(const Arguments& args) {
     HandleScope scope;
     Statement* stmt = ObjectWrap::Unwrap<Statement>(args.This());
 
-    Baton* baton = stmt->Bind<RowsBaton>(args);
-    if (baton == NULL) {
-        return ThrowException(Exception::Error(String::New("Data type is not supported")));
+    if (args.Length() <= 0 || !args[0]->IsArray()) {
+        return ThrowException(Exception::TypeError(
+            String::New("Array of parameter sets expected")));
     }
-    else {
-        stmt->Schedule(Work_BeginAll, baton);
-        return args.This();
+
+    int pos = 1;
+    Local<Object> options;
+    if (args.Length() > pos && args[pos]->IsObject() && !args[pos]->IsFunction()) {
+        options = args[pos++]->ToObject();
+    }
+
+    Local<Function> callback;
+    if (args.Length() > pos && !args[pos]->IsUndefined()) {
+        if (!args[pos]->IsFunction()) {
+            return ThrowException(Exception::TypeError(
+                String::New("Callback expected")));
+        }
+        callback = Local<Function>::Cast(args[pos]);
+    }
+
+    BatchBaton* baton = new BatchBaton(stmt, callback);
+
+    if (!options.IsEmpty()) {
+        baton->transaction = options->Get(String::NewSymbol("transaction"))->BooleanValue();
+        baton->aggregate = options->Get(String::NewSymbol("aggregate"))->BooleanValue();
+    }
+
+    Local<Array> sets = Local<Array>::Cast(args[0]);
+    int length = sets->Length();
+    baton->sets.resize(length);
+    for (int i = 0; i < length; i++) {
+        stmt->BindSet(sets->Get(i), baton->sets[i], baton);
     }
+
+    stmt->Schedule(Work_BeginRunBatch, baton);
+    return args.This();
 }
 
-void Statement::Work_BeginAll(Baton* baton) {
-    STATEMENT_BEGIN(All);
+void Statement::Work_BeginRunBatch(Baton* baton) {
+    STATEMENT_BEGIN(RunBatch);
 }
 
-void Statement::Work_All(uv_work_t* req) {
-    STATEMENT_INIT(RowsBaton);
+void Statement::Work_RunBatch(uv_work_t* req) {
+    STATEMENT_INIT(BatchBaton);
+
+    sqlite3* db = stmt->connection;
 
-    sqlite3_mutex* mtx = sqlite3_db_mutex(stmt->db->handle);
+    // Hold the connection for the whole batch so that no other statement
+    // runs inside our savepoint.
+    sqlite3_mutex* mtx = sqlite3_db_mutex(db);
     sqlite3_mutex_enter(mtx);
 
-    // Make sure that we also reset when there are no parameters.
-    if (!baton->parameters.size()) {
-        sqlite3_reset(stmt->handle);
+    stmt->GroupCommitBefore(baton);
+    stmt->status = SQLITE_DONE;
+
+    size_t savepoint = stmt->UpdateMark();
+    if (baton->transaction) {
+        int status = sqlite3_exec(db, "SAVEPOINT node_sqlite3_batch", NULL, NULL, NULL);
+        if (status != SQLITE_OK) {
+            stmt->status = status;
+            stmt->message = std::string(sqlite3_errmsg(db));
+            stmt->Committed();
+            stmt->db->LeaveConnection(mtx);
+            return;
+        }
     }
 
-    if (stmt->Bind(baton->parameters)) {
-        while ((stmt->status = sqlite3_step(stmt->handle)) == SQLITE_ROW) {
-            Row* row = new Row();
-            GetRow(row, stmt->handle);
-            baton->rows.push_back(row);
+    if (!baton->aggregate) {
+        baton->inserted_ids.reserve(baton->sets.size());
+        baton->row_changes.reserve(baton->sets.size());
+    }
+
+    for (unsigned int i = 0; i < baton->sets.size(); i++) {
+        // Make sure that we also reset when there are no parameters.
+        if (!baton->sets[i].size()) {
+            sqlite3_reset(stmt->handle);
         }
 
-        if (stmt->status != SQLITE_DONE) {
-            stmt->message = std::string(sqlite3_errmsg(stmt->db->handle));
+        if (!stmt->Bind(baton->sets[i])) {
+            break;
+        }
+
+        size_t mark = stmt->UpdateMark();
+        stmt->status = sqlite3_step(stmt->handle);
+
+        if (!(stmt->status == SQLITE_ROW || stmt->status == SQLITE_DONE)) {
+            stmt->message = std::string(sqlite3_errmsg(db));
+            stmt->UpdateUndo(mark);
+            break;
+        }
+
+        baton->inserted_id = sqlite3_last_insert_rowid(db);
+        int changes = sqlite3_changes(db);
+        baton->changes += changes;
+        if (!baton->aggregate) {
+            baton->inserted_ids.push_back(baton->inserted_id);
+            baton->row_changes.push_back(changes);
         }
     }
 
-    sqlite3_mutex_leave(mtx);
+    if (baton->transaction) {
+        if (stmt->status == SQLITE_ROW || stmt->status == SQLITE_DONE) {
+            int status = sqlite3_exec(db, "RELEASE node_sqlite3_batch", NULL, NULL, NULL);
+            if (status != SQLITE_OK) {
+                stmt->status = status;
+                stmt->message = std::string(sqlite3_errmsg(db));
+            }
+        }
+        if (stmt->status != SQLITE_ROW && stmt->status != SQLITE_DONE) {
+            // Undo the rows inserted before the failure.
+            sqlite3_reset(stmt->handle);
+            sqlite3_exec(db, "ROLLBACK TO node_sqlite3_batch", NULL, NULL, NULL);
+            stmt->UpdateUndo(savepoint);
+            sqlite3_exec(db, "RELEASE node_sqlite3_batch", NULL, NULL, NULL);
+            baton->changes = 0;
+        }
+    }
+
+    stmt->Committed();
+    stmt->db->LeaveConnection(mtx);
 }
 
-void Statement::Work_AfterAll(uv_work_t* req) {
+void Statement::Work_AfterRunBatch(uv_work_t* req) {
     HandleScope scope;
-    STATEMENT_INIT(RowsBaton);
+    STATEMENT_INIT(BatchBaton);
 
-    if (stmt->status != SQLITE_DONE) {
+    stmt->GroupCommitReport(baton);
+
+    if (stmt->status != SQLITE_ROW && stmt->status != SQLITE_DONE) {
         Error(baton);
     }
     else {
         // Fire callbacks.
         if (!baton->callback.IsEmpty() && baton->callback->IsFunction()) {
-            if (baton->rows.size()) {
-                // Create the result array from the data we acquired.
-                Local<Array> result(Array::New(baton->rows.size()));
-                Rows::const_iterator it = baton->rows.begin();
-                Rows::const_iterator end = baton->rows.end();
-                for (int i = 0; it < end; ++it, i++) {
-                    result->Set(i, RowToJS(*it));
-                    delete *it;
-                }
+            stmt->handle_->Set(String::NewSymbol("lastID"), Local<Integer>(Integer::New(baton->inserted_id)));
+            stmt->handle_->Set(String::NewSymbol("changes"), Local<Integer>(Integer::New(baton->changes)));
 
-                Local<Value> argv[] = { Local<Value>::New(Null()), result };
-                TRY_CATCH_CALL(stmt->handle_, baton->callback, 2, argv);
+            Local<Value> result;
+            if (baton->aggregate) {
+                result = Integer::New(baton->changes);
             }
             else {
-                // There were no result rows.
-                Local<Value> argv[] = {
-                    Local<Value>::New(Null()),
-                    Local<Value>::New(Array::New(0))
-                };
-                TRY_CATCH_CALL(stmt->handle_, baton->callback, 2, argv);
+                Local<Array> rows(Array::New(baton->row_changes.size()));
+                for (unsigned int i = 0; i < baton->row_changes.size(); i++) {
+                    Local<Object> row(Object::New());
+                    row->Set(String::NewSymbol("lastID"), Local<Integer>(Integer::New(baton->inserted_ids[i])));
+                    row->Set(String::NewSymbol("changes"), Local<Integer>(Integer::New(baton->row_changes[i])));
+                    rows->Set(i, row);
+                }
+                result = rows;
             }
+
+            Local<Value> argv[] = { Local<Value>::New(Null()), result };
+            TRY_CATCH_CALL(stmt->handle_, baton->callback, 2, argv);
         }
     }
 
     STATEMENT_END();
 }
 
-Handle<Value> Statement::Each(const Arguments& args) {
+// Statement#runColumns(columns, [options], [callback])
+// Runs the statement once per element of the column arrays, binding row i
+// from element i of every column. Keys of the columns object are parameter
+// names or positions like those of a parameter object; an array of columns
+// binds them by position. Typed arrays are read in place, so that the whole
+// run is a single trip to the thread pool inside one transaction. The
+// timeoutMs option applies to the whole run.
+Handle<Value> Statement::RunColumns(const Arguments& args) {
     HandleScope scope;
     Statement* stmt = ObjectWrap::Unwrap<Statement>(args.This());
 
-    int last = args.Length();
+    if (args.Length() <= 0 || !args[0]->IsObject() || args[0]->IsFunction()) {
+        return ThrowException(Exception::TypeError(
+            String::New("Object of columns expected")));
+    }
 
-    Local<Function> completed;
-    if (last >= 2 && args[last - 1]->IsFunction() && args[last - 2]->IsFunction()) {
-        completed = Local<Function>::Cast(args[--last]);
+    int pos = 1;
+    Local<Object> options;
+    if (args.Length() > pos && args[pos]->IsObject() && !args[pos]->IsFunction()) {
+        options = args[pos++]->ToObject();
     }
 
-    EachBaton* baton = stmt->Bind<EachBaton>(args, 0, last);
-    if (baton == NULL) {
-        return ThrowException(Exception::Error(String::New("Data type is not supported")));
+    Local<Function> callback;
+    if (args.Length() > pos && !args[pos]->IsUndefined()) {
+        if (!args[pos]->IsFunction()) {
+            return ThrowException(Exception::TypeError(
+                String::New("Callback expected")));
+        }
+        callback = Local<Function>::Cast(args[pos]);
     }
-    else {
-        baton->completed = Persistent<Function>::New(completed);
-        stmt->Schedule(Work_BeginEach, baton);
-        return args.This();
+
+    ColumnsBaton* baton = new ColumnsBaton(stmt, callback);
+
+    if (!options.IsEmpty()) {
+        double timeout = options->Get(String::NewSymbol("timeoutMs"))->NumberValue();
+        if (timeout > 0) {
+            baton->deadline = uv_hrtime() + (uint64_t)(timeout * 1e6);
+        }
     }
-}
 
-void Statement::Work_BeginEach(Baton* baton) {
-    // Only create the Async object when we're actually going into
-    // the event loop. This prevents dangling events.
-    EachBaton* each_baton = static_cast<EachBaton*>(baton);
-    each_baton->async = new Async(each_baton->stmt, AsyncEach);
-    each_baton->async->item_cb = Persistent<Function>::New(each_baton->callback);
-    each_baton->async->completed_cb = Persistent<Function>::New(each_baton->completed);
+    Local<Object> object = args[0]->ToObject();
+    bool positional = args[0]->IsArray();
+    Local<Array> names = object->GetPropertyNames();
+    int count = positional ? Local<Array>::Cast(args[0])->Length() : names->Length();
 
-    STATEMENT_BEGIN(Each);
-}
+    for (int i = 0; i < count; i++) {
+        baton->sources.push_back(Column());
+        Column& column = baton->sources.back();
+
+        Local<Value> value;
+        if (positional) {
+            column.index = i + 1;
+            value = object->Get(i);
+        }
+        else {
+            Local<Value> name = names->Get(i);
+            if (name->IsInt32()) {
+                column.index = name->Int32Value();
+            }
+            else {
+                column.name = *String::Utf8Value(name);
+            }
+            value = object->Get(name);
+        }
+
+        size_t length;
+        if (value->IsObject() && value->ToObject()->HasIndexedPropertiesInExternalArrayData()) {
+            Local<Object> array = value->ToObject();
+            column.data = array->GetIndexedPropertiesExternalArrayData();
+            column.type = array->GetIndexedPropertiesExternalArrayDataType();
+            length = array->GetIndexedPropertiesExternalArrayDataLength();
+            // Keep the memory alive while the worker reads it.
+            baton->pins.push_back(Persistent<Object>::New(array));
+        }
+        else if (value->IsArray()) {
+            Local<Array> array = Local<Array>::Cast(value);
+            length = array->Length();
+            column.values.reserve(length);
+            for (size_t j = 0; j < length; j++) {
+                Values::Field* field = stmt->BindParameter(array->Get(j), column.index, baton);
+                if (field == NULL) {
+                    delete baton;
+                    return ThrowException(Exception::Error(
+                        String::New("Data type is not supported")));
+                }
+                column.values.push_back(field);
+            }
+        }
+        else {
+            delete baton;
+            return ThrowException(Exception::TypeError(
+                String::New("Columns must be typed arrays or arrays")));
+        }
+
+        if (i == 0) {
+            baton->length = length;
+        }
+        else if (length != baton->length) {
+            delete baton;
+            return ThrowException(Exception::TypeError(
+                String::New("Columns must have the same length")));
+        }
+    }
+
+    stmt->Schedule(Work_BeginRunColumns, baton);
+    return args.This();
+}
+
+void Statement::Work_BeginRunColumns(Baton* baton) {
+    STATEMENT_BEGIN(RunColumns);
+}
+
+void Statement::Work_RunColumns(uv_work_t* req) {
+    STATEMENT_INIT(ColumnsBaton);
+
+    sqlite3* db = stmt->connection;
+
+    // Hold the connection for the whole run so that no other statement
+    // runs inside our savepoint.
+    sqlite3_mutex* mtx = sqlite3_db_mutex(db);
+    sqlite3_mutex_enter(mtx);
+
+    stmt->GroupCommitBefore(baton);
+    size_t savepoint = stmt->UpdateMark();
+    stmt->status = sqlite3_exec(db, "SAVEPOINT node_sqlite3_columns", NULL, NULL, NULL);
+    if (stmt->status != SQLITE_OK) {
+        stmt->message = std::string(sqlite3_errmsg(db));
+        stmt->Committed();
+        stmt->db->LeaveConnection(mtx);
+        return;
+    }
+    stmt->status = SQLITE_DONE;
+
+    std::vector<Column>& sources = baton->sources;
+    for (unsigned int c = 0; c < sources.size(); c++) {
+        if (sources[c].index == 0) {
+            sources[c].index = sqlite3_bind_parameter_index(stmt->handle,
+                sources[c].name.c_str());
+        }
+    }
+
+    sqlite3_reset(stmt->handle);
+    sqlite3_clear_bindings(stmt->handle);
+
+    stmt->BeginTimeout(baton);
+    for (size_t i = 0; i < baton->length; i++) {
+        for (unsigned int c = 0; c < sources.size(); c++) {
+            int status = stmt->BindColumn(sources[c], i);
+            if (status != SQLITE_OK) {
+                stmt->status = status;
+                break;
+            }
+        }
+        if (stmt->status == SQLITE_DONE) {
+            stmt->status = sqlite3_step(stmt->handle);
+        }
+        if (!(stmt->status == SQLITE_ROW || stmt->status == SQLITE_DONE)) {
+            stmt->message = std::string(sqlite3_errmsg(db));
+            break;
+        }
+        sqlite3_reset(stmt->handle);
+        stmt->status = SQLITE_DONE;
+
+        baton->inserted_id = sqlite3_last_insert_rowid(db);
+        baton->changes += sqlite3_changes(db);
+    }
+    // Before the savepoint is released or rolled back, which must not be
+    // interrupted.
+    stmt->EndTimeout(baton);
+
+    if (stmt->status == SQLITE_DONE) {
+        int status = sqlite3_exec(db, "RELEASE node_sqlite3_columns", NULL, NULL, NULL);
+        if (status != SQLITE_OK) {
+            stmt->status = status;
+            stmt->message = std::string(sqlite3_errmsg(db));
+        }
+    }
+    if (stmt->status != SQLITE_DONE) {
+        // Undo the rows inserted before the failure.
+        sqlite3_reset(stmt->handle);
+        sqlite3_exec(db, "ROLLBACK TO node_sqlite3_columns", NULL, NULL, NULL);
+        stmt->UpdateUndo(savepoint);
+        sqlite3_exec(db, "RELEASE node_sqlite3_columns", NULL, NULL, NULL);
+        baton->changes = 0;
+    }
+
+    stmt->Committed();
+    stmt->db->LeaveConnection(mtx);
+}
+
+void Statement::Work_AfterRunColumns(uv_work_t* req) {
+    HandleScope scope;
+    STATEMENT_INIT(ColumnsBaton);
+
+    stmt->GroupCommitReport(baton);
+
+    if (stmt->status != SQLITE_DONE) {
+        Error(baton);
+    }
+    else {
+        // Fire callbacks.
+        if (!baton->callback.IsEmpty() && baton->callback->IsFunction()) {
+            stmt->handle_->Set(String::NewSymbol("lastID"), Local<Integer>(Integer::New(baton->inserted_id)));
+            stmt->handle_->Set(String::NewSymbol("changes"), Local<Integer>(Integer::New(baton->changes)));
+
+            Local<Value> argv[] = { Local<Value>::New(Null()), Integer::New(baton->changes) };
+            TRY_CATCH_CALL(stmt->handle_, baton->callback, 2, argv);
+        }
+    }
+
+    STATEMENT_END();
+}
+
+Handle<Value> Statement::All(const Arguments& args) {
+    HandleScope scope;
+    Statement* stmt = ObjectWrap::Unwrap<Statement>(args.This());
+
+    Baton* baton = stmt->Bind<RowsBaton>(args);
+    if (baton == NULL) {
+        return ThrowException(Exception::Error(String::New("Data type is not supported")));
+    }
+    else {
+        stmt->Schedule(Work_BeginAll, baton);
+        return args.This();
+    }
+}
+
+void Statement::Work_BeginAll(Baton* baton) {
+    STATEMENT_BEGIN(All);
+}
+
+void Statement::Work_All(uv_work_t* req) {
+    STATEMENT_INIT(RowsBaton);
+
+    int load = stmt->Route(true, baton->parameters.size() > 0);
+    sqlite3_mutex* mtx = sqlite3_db_mutex(stmt->connection);
+    sqlite3_mutex_enter(mtx);
+
+    // Make sure that we also reset when there are no parameters.
+    if (!baton->parameters.size()) {
+        sqlite3_reset(stmt->handle);
+    }
+
+    if (stmt->Bind(baton->parameters)) {
+        stmt->GroupCommitBefore(baton);
+        stmt->BeginTimeout(baton);
+        while ((stmt->status = sqlite3_step(stmt->handle)) == SQLITE_ROW) {
+            if (baton->rows.Empty()) {
+                baton->columns = stmt->UpdateColumns();
+            }
+            baton->rows.Append(stmt->handle);
+        }
+
+        if (stmt->status != SQLITE_DONE) {
+            stmt->message = std::string(sqlite3_errmsg(stmt->connection));
+        }
+        stmt->EndTimeout(baton);
+    }
+
+    stmt->Committed();
+    stmt->db->LeaveConnection(mtx);
+    if (load >= 0) stmt->db->ReleaseReader(load);
+}
+
+void Statement::Work_AfterAll(uv_work_t* req) {
+    HandleScope scope;
+    STATEMENT_INIT(RowsBaton);
+
+    stmt->ReportRows(baton);
+
+    if (stmt->status != SQLITE_DONE) {
+        Error(baton);
+    }
+    else {
+        // Fire callbacks.
+        if (!baton->callback.IsEmpty() && baton->callback->IsFunction()) {
+            if (!baton->rows.Empty()) {
+                // Create the result array from the data we acquired.
+                size_t length = baton->rows.Length();
+                Local<Array> result(Array::New(length));
+                for (size_t i = 0; i < length; i++) {
+                    result->Set(i, stmt->RowToJS(baton->rows, i));
+                }
+
+                Local<Value> argv[] = { Local<Value>::New(Null()), result };
+                TRY_CATCH_CALL(stmt->handle_, baton->callback, 2, argv);
+            }
+            else {
+                // There were no result rows.
+                Local<Value> argv[] = {
+                    Local<Value>::New(Null()),
+                    Local<Value>::New(Array::New(0))
+                };
+                TRY_CATCH_CALL(stmt->handle_, baton->callback, 2, argv);
+            }
+        }
+    }
+
+    STATEMENT_END();
+}
+
+Handle<Value> Statement::Each(const Arguments& args) {
+    HandleScope scope;
+    Statement* stmt = ObjectWrap::Unwrap<Statement>(args.This());
+
+    int last = args.Length();
+
+    Local<Function> completed;
+    if (last >= 2 && args[last - 1]->IsFunction() && args[last - 2]->IsFunction()) {
+        completed = Local<Function>::Cast(args[--last]);
+    }
+
+    EachBaton* baton = stmt->Bind<EachBaton>(args, 0, last);
+    if (baton == NULL) {
+        return ThrowException(Exception::Error(String::New("Data type is not supported")));
+    }
+    else {
+        baton->completed = Persistent<Function>::New(completed);
+        stmt->Schedule(Work_BeginEach, baton);
+        return args.This();
+    }
+}
+
+void Statement::Work_BeginEach(Baton* baton) {
+    // Only create the Async object when we're actually going into
+    // the event loop. This prevents dangling events.
+    EachBaton* each_baton = static_cast<EachBaton*>(baton);
+    each_baton->async = new Async(each_baton->stmt, AsyncEach);
+    each_baton->async->item_cb = Persistent<Function>::New(each_baton->callback);
+    each_baton->async->completed_cb = Persistent<Function>::New(each_baton->completed);
+
+    STATEMENT_BEGIN(Each);
+}
 
 void Statement::Work_Each(uv_work_t* req) {
     STATEMENT_INIT(EachBaton);
 
     Async* async = baton->async;
+    const Database::EachLimits& limits = async->limits;
 
-    sqlite3_mutex* mtx = sqlite3_db_mutex(stmt->db->handle);
+    int load = stmt->Route(true, baton->parameters.size() > 0);
+    sqlite3_mutex* mtx = sqlite3_db_mutex(stmt->connection);
 
     int retrieved = 0;
+    Async::Chunk* chunk = NULL;
 
     // Make sure that we also reset when there are no parameters.
     if (!baton->parameters.size()) {
@@ -614,30 +1445,114 @@ void Statement::Work_Each(uv_work_t* req) {
     if (stmt->Bind(baton->parameters)) {
         while (true) {
             sqlite3_mutex_enter(mtx);
+            if (!retrieved) stmt->GroupCommitBefore(baton);
+            stmt->BeginTimeout(baton);
             stmt->status = sqlite3_step(stmt->handle);
             if (stmt->status == SQLITE_ROW) {
-                sqlite3_mutex_leave(mtx);
-                Row* row = new Row();
-                GetRow(row, stmt->handle);
-                NODE_SQLITE3_MUTEX_LOCK(&async->mutex)
-                async->data.push_back(row);
+                Columns* columns = retrieved ? NULL : stmt->UpdateColumns();
+                stmt->EndTimeout(baton);
+                stmt->db->LeaveConnection(mtx);
+
+                if (chunk == NULL) {
+                    chunk = async->Take();
+                }
+                if (columns != NULL) {
+                    chunk->columns = columns;
+                }
+                size_t bytes = chunk->rows.Append(stmt->handle);
+                NODE_SQLITE3_ATOMIC_ADD(&async->buffered, 1)
+                NODE_SQLITE3_ATOMIC_ADD(&async->buffered_bytes, bytes)
                 retrieved++;
-                NODE_SQLITE3_MUTEX_UNLOCK(&async->mutex)
 
-                uv_async_send(&async->watcher);
+                bool full = async->Full();
+                if (chunk->rows.Length() >= limits.chunk_size || full) {
+                    async->Push(chunk);
+                    chunk = NULL;
+                }
+
+                if (full) {
+                    // Park until the item callbacks caught up.
+                    async->Park();
+                }
             }
             else {
                 if (stmt->status != SQLITE_DONE) {
-                    stmt->message = std::string(sqlite3_errmsg(stmt->db->handle));
+                    stmt->message = std::string(sqlite3_errmsg(stmt->connection));
                 }
-                sqlite3_mutex_leave(mtx);
+                stmt->EndTimeout(baton);
+                stmt->Committed();
+                stmt->db->LeaveConnection(mtx);
                 break;
             }
         }
     }
 
-    async->completed = true;
-    uv_async_send(&async->watcher);
+    if (chunk != NULL) {
+        async->Push(chunk);
+    }
+    if (load >= 0) stmt->db->ReleaseReader(load);
+
+    NODE_SQLITE3_MEMORY_BARRIER
+    async->completed = 1;
+    async->Wake();
+}
+
+Statement::Async::Chunk* Statement::Async::Take() {
+    Chunk* chunk;
+    if (spare.pop(chunk)) {
+        return chunk;
+    }
+    return new Chunk();
+}
+
+void Statement::Async::Push(Chunk* chunk) {
+    if (!chunks.push(chunk)) {
+        // Wait for the main thread to make room. It signals after each
+        // chunk it took out.
+        Wake();
+        NODE_SQLITE3_MUTEX_LOCK(&mutex)
+        while (!chunks.push(chunk)) {
+            NODE_SQLITE3_COND_WAIT(&cond, &mutex)
+        }
+        NODE_SQLITE3_MUTEX_UNLOCK(&mutex)
+    }
+    Wake();
+}
+
+bool Statement::Async::Full() {
+    return (limits.high_water && buffered >= limits.high_water) ||
+        (limits.high_water_bytes && buffered_bytes >= limits.high_water_bytes);
+}
+
+void Statement::Async::Park() {
+    NODE_SQLITE3_MUTEX_LOCK(&mutex)
+    while ((limits.high_water && buffered > limits.low_water) ||
+            (limits.high_water_bytes && buffered_bytes > limits.low_water_bytes)) {
+        NODE_SQLITE3_COND_WAIT(&cond, &mutex)
+    }
+    NODE_SQLITE3_MUTEX_UNLOCK(&mutex)
+}
+
+// Only sends a wake-up when the main thread isn't already due to run.
+void Statement::Async::Wake() {
+    if (NODE_SQLITE3_ATOMIC_CAS(&signaled, 0, 1)) {
+        uv_async_send(&watcher);
+    }
+}
+
+void Statement::Async::Return(Chunk* chunk) {
+    unsigned long rows = chunk->rows.Length();
+    unsigned long bytes = chunk->rows.Size();
+    chunk->rows.Clear();
+    if (!spare.push(chunk)) {
+        delete chunk;
+    }
+
+    NODE_SQLITE3_ATOMIC_SUB(&buffered, rows)
+    NODE_SQLITE3_ATOMIC_SUB(&buffered_bytes, bytes)
+    NODE_SQLITE3_MUTEX_LOCK(&mutex)
+    NODE_SQLITE3_COND_SIGNAL(&cond)
+    NODE_SQLITE3_MUTEX_UNLOCK(&mutex)
 }
 
 void Statement::CloseCallback(uv_handle_t* handle) {
@@ -651,33 +1566,37 @@ void Statement::AsyncEach(uv_async_t* handle, int status) {
     HandleScope scope;
     Async* async = static_cast<Async*>(handle->data);
 
-    while (true) {
-        // Get the contents out of the data cache for us to process in the JS callback.
-        Rows rows;
-        NODE_SQLITE3_MUTEX_LOCK(&async->mutex)
-        rows.swap(async->data);
-        NODE_SQLITE3_MUTEX_UNLOCK(&async->mutex)
-
-        if (rows.empty()) {
-            break;
+    // Reset before draining: chunks pushed from now on send a new wake-up.
+    // Completion is read first so that no chunk pushed before it is missed.
+    async->signaled = 0;
+    NODE_SQLITE3_MEMORY_BARRIER
+    bool completed = async->completed;
+    NODE_SQLITE3_MEMORY_BARRIER
+
+    Async::Chunk* chunk;
+    while (async->chunks.pop(chunk)) {
+        if (chunk->columns != NULL) {
+            async->stmt->SetColumns(chunk->columns);
+            delete chunk->columns;
+            chunk->columns = NULL;
         }
 
         if (!async->item_cb.IsEmpty() && async->item_cb->IsFunction()) {
             Local<Value> argv[2];
             argv[0] = Local<Value>::New(Null());
 
-            Rows::const_iterator it = rows.begin();
-            Rows::const_iterator end = rows.end();
-            for (int i = 0; it < end; ++it, i++) {
-                argv[1] = RowToJS(*it);
+            Rows& rows = chunk->rows;
+            for (size_t i = 0, length = rows.Length(); i < length; i++) {
+                argv[1] = async->stmt->RowToJS(rows, i);
                 async->retrieved++;
                 TRY_CATCH_CALL(async->stmt->handle_, async->item_cb, 2, argv);
-                delete *it;
             }
         }
+
+        async->Return(chunk);
     }
 
-    if (async->completed) {
+    if (completed) {
         if (!async->completed_cb.IsEmpty() &&
                 async->completed_cb->IsFunction()) {
             Local<Value> argv[] = {
@@ -694,6 +1613,8 @@ void Statement::Work_AfterEach(uv_work_t* req) {
     HandleScope scope;
     STATEMENT_INIT(EachBaton);
 
+    stmt->GroupCommitReport(baton);
+
     if (stmt->status != SQLITE_DONE) {
         Error(baton);
     }
@@ -701,6 +1622,90 @@ void Statement::Work_AfterEach(uv_work_t* req) {
     STATEMENT_END();
 }
 
+// Statement#fetch(count, [callback])
+// Steps the statement from its current position and retrieves up to count
+// rows. The callback receives the rows and whether the end was reached.
+Handle<Value> Statement::Fetch(const Arguments& args) {
+    HandleScope scope;
+    Statement* stmt = ObjectWrap::Unwrap<Statement>(args.This());
+
+    REQUIRE_ARGUMENTS(1);
+    OPTIONAL_ARGUMENT_INTEGER(0, count, 1);
+    OPTIONAL_ARGUMENT_FUNCTION(1, callback);
+
+    if (count <= 0) {
+        return ThrowException(Exception::RangeError(
+            String::New("Count must be positive")));
+    }
+
+    Baton* baton = new FetchBaton(stmt, callback, count);
+    stmt->Schedule(Work_BeginFetch, baton);
+
+    return args.This();
+}
+
+void Statement::Work_BeginFetch(Baton* baton) {
+    STATEMENT_BEGIN(Fetch);
+}
+
+void Statement::Work_Fetch(uv_work_t* req) {
+    STATEMENT_INIT(FetchBaton);
+
+    // Continues the cursor where it is.
+    int load = stmt->Route(false, false);
+    sqlite3_mutex* mtx = sqlite3_db_mutex(stmt->connection);
+    sqlite3_mutex_enter(mtx);
+
+    stmt->GroupCommitBefore(baton);
+    stmt->BeginTimeout(baton);
+    while ((int)baton->rows.Length() < baton->count &&
+            (stmt->status = sqlite3_step(stmt->handle)) == SQLITE_ROW) {
+        if (baton->rows.Empty()) {
+            baton->columns = stmt->UpdateColumns();
+        }
+        baton->rows.Append(stmt->handle);
+    }
+
+    if (stmt->status != SQLITE_ROW && stmt->status != SQLITE_DONE) {
+        stmt->message = std::string(sqlite3_errmsg(stmt->connection));
+    }
+    stmt->EndTimeout(baton);
+
+    stmt->Committed();
+    stmt->db->LeaveConnection(mtx);
+    if (load >= 0) stmt->db->ReleaseReader(load);
+}
+
+void Statement::Work_AfterFetch(uv_work_t* req) {
+    HandleScope scope;
+    STATEMENT_INIT(FetchBaton);
+
+    stmt->ReportRows(baton);
+
+    if (stmt->status != SQLITE_ROW && stmt->status != SQLITE_DONE) {
+        Error(baton);
+    }
+    else {
+        // Fire callbacks.
+        if (!baton->callback.IsEmpty() && baton->callback->IsFunction()) {
+            size_t length = baton->rows.Length();
+            Local<Array> result(Array::New(length));
+            for (size_t i = 0; i < length; i++) {
+                result->Set(i, stmt->RowToJS(baton->rows, i));
+            }
+
+            Local<Value> argv[] = {
+                Local<Value>::New(Null()),
+                result,
+                Local<Value>::New(Boolean::New(stmt->status == SQLITE_DONE))
+            };
+            TRY_CATCH_CALL(stmt->handle_, baton->callback, 3, argv);
+        }
+    }
+
+    STATEMENT_END();
+}
+
 Handle<Value> Statement::Reset(const Arguments& args) {
     HandleScope scope;
     Statement* stmt = ObjectWrap::Unwrap<Statement>(args.This());
@@ -737,31 +1742,302 @@ void Statement::Work_AfterReset(uv_work_t* req) {
     STATEMENT_END();
 }
 
-Local<Object> Statement::RowToJS(Row* row) {
+void Statement::Work_BeginPipeline(Baton* baton) {
+    STATEMENT_BEGIN(Pipeline);
+}
+
+void Statement::Work_Pipeline(uv_work_t* req) {
+    STATEMENT_INIT(PipelineBaton);
+
+    for (unsigned int i = 0; i < baton->items.size(); i++) {
+        PipelineBaton::Item& item = baton->items[i];
+        item.work(&item.baton->request);
+        item.status = stmt->status;
+        if (stmt->status != SQLITE_OK && stmt->status != SQLITE_ROW &&
+                stmt->status != SQLITE_DONE) {
+            item.message = stmt->message;
+        }
+    }
+}
+
+void Statement::Work_AfterPipeline(uv_work_t* req) {
+    HandleScope scope;
+    STATEMENT_INIT(PipelineBaton);
+
+    // The statement stays locked until all callbacks have been fired.
+    stmt->pipelined = true;
+    for (unsigned int i = 0; i < baton->items.size(); i++) {
+        PipelineBaton::Item& item = baton->items[i];
+        stmt->status = item.status;
+        stmt->message = item.message;
+        item.after(&item.baton->request);
+    }
+    stmt->pipelined = false;
+
+    STATEMENT_END();
+}
+
+// Returns the error to throw when the statement can't run synchronously
+// because it is finalized or has work queued or running in the thread pool.
+Local<Value> Statement::SyncError() {
+    const char* message = NULL;
+    if (finalized) {
+        message = "Statement is already finalized";
+    }
+    else if (!db->open) {
+        message = "Database is closed";
+    }
+    else if (db->IsBusy()) {
+        message = "Database is busy";
+    }
+    else if (!prepared || locked || !queue.empty()) {
+        message = "Statement is busy";
+    }
+
+    if (message == NULL) {
+        return Local<Value>();
+    }
+    EXCEPTION(String::New(message), SQLITE_MISUSE, exception);
+    return exception;
+}
+
+// Locks the connection for a synchronous call, which must not wait for a
+// worker on the main thread. Moves a query off its reader when a transaction
+// is open on the primary connection. Returns NULL when a worker holds one
+// of the connections.
+sqlite3_mutex* Statement::SyncLock() {
+    sqlite3_mutex* primary = sqlite3_db_mutex(db->handle);
+    if (sqlite3_mutex_try(primary) != SQLITE_OK) {
+        return NULL;
+    }
+    if (connection == db->handle) {
+        pinned = true;
+        return primary;
+    }
+
+    sqlite3_mutex* mtx = sqlite3_db_mutex(connection);
+    if (sqlite3_mutex_try(mtx) != SQLITE_OK) {
+        sqlite3_mutex_leave(primary);
+        return NULL;
+    }
+    if (sqlite3_get_autocommit(db->handle) || !Move(-1)) {
+        sqlite3_mutex_leave(primary);
+        pinned = true;
+        return mtx;
+    }
+    sqlite3_mutex_leave(mtx);
+    pinned = true;
+    return primary;
+}
+
+void Statement::SyncUnlock(sqlite3_mutex* mtx) {
+    pinned = false;
+    sqlite3_mutex_leave(mtx);
+}
+
+// Statement#status([reset])
+// Returns the sqlite3_stmt_status counters of the statement. They are plain
+// counters that can be read while the statement steps on a worker; before
+// the statement is prepared they are all 0.
+Handle<Value> Statement::Status(const Arguments& args) {
+    HandleScope scope;
+    Statement* stmt = ObjectWrap::Unwrap<Statement>(args.This());
+
+    if (stmt->finalized) {
+        EXCEPTION(String::New("Statement is already finalized"), SQLITE_MISUSE, exception);
+        return ThrowException(exception);
+    }
+
+    int reset = args.Length() > 0 && args[0]->BooleanValue();
+    int fullscan = 0, sort = 0, autoindex = 0;
+    if (stmt->prepared && stmt->handle) {
+        // Queries run on whichever connection is free, so their counters
+        // are spread over the handles on each of them.
+        NODE_SQLITE3_MUTEX_LOCK(&stmt->mutex)
+        for (unsigned int i = 0; i <= stmt->idle.size(); i++) {
+            sqlite3_stmt* handle = i < stmt->idle.size() ? stmt->idle[i] : stmt->handle;
+            if (handle == NULL) continue;
+            fullscan += sqlite3_stmt_status(handle, SQLITE_STMTSTATUS_FULLSCAN_STEP, reset);
+            sort += sqlite3_stmt_status(handle, SQLITE_STMTSTATUS_SORT, reset);
+            autoindex += sqlite3_stmt_status(handle, SQLITE_STMTSTATUS_AUTOINDEX, reset);
+        }
+        NODE_SQLITE3_MUTEX_UNLOCK(&stmt->mutex)
+    }
+
+    Local<Object> status = Object::New();
+    status->Set(String::NewSymbol("fullscanStep"), Integer::New(fullscan));
+    status->Set(String::NewSymbol("sort"), Integer::New(sort));
+    status->Set(String::NewSymbol("autoindex"), Integer::New(autoindex));
+
+    return scope.Close(status);
+}
+
+// Statement#getSync([bind1, bind2, ...])
+// Binds, steps and converts the row on the calling thread.
+Handle<Value> Statement::GetSync(const Arguments& args) {
+    HandleScope scope;
+    Statement* stmt = ObjectWrap::Unwrap<Statement>(args.This());
+
+    Local<Value> error = stmt->SyncError();
+    if (!error.IsEmpty()) {
+        return ThrowException(error);
+    }
+
+    RowBaton* baton = stmt->Bind<RowBaton>(args);
+    if (baton == NULL) {
+        return ThrowException(Exception::Error(String::New("Data type is not supported")));
+    }
+
+    sqlite3_mutex* mtx = stmt->SyncLock();
+    if (mtx == NULL) {
+        delete baton;
+        EXCEPTION(String::New("Database is busy"), SQLITE_MISUSE, exception);
+        return ThrowException(exception);
+    }
+    Work_Get(&baton->request);
+    stmt->SyncUnlock(mtx);
+    stmt->ReportRows(baton);
+
+    if (stmt->status != SQLITE_ROW && stmt->status != SQLITE_DONE) {
+        EXCEPTION(String::New(stmt->message.c_str()), stmt->status, exception);
+        delete baton;
+        return ThrowException(exception);
+    }
+
+    Local<Value> result;
+    if (stmt->status == SQLITE_ROW) {
+        result = stmt->RowToJS(baton->row, 0);
+    }
+    else {
+        result = Local<Value>::New(Undefined());
+    }
+
+    delete baton;
+    return scope.Close(result);
+}
+
+// Statement#runSync([bind1, bind2, ...])
+// Returns { lastID, changes }. With group commit enabled, the write may not
+// be committed yet when this returns.
+Handle<Value> Statement::RunSync(const Arguments& args) {
+    HandleScope scope;
+    Statement* stmt = ObjectWrap::Unwrap<Statement>(args.This());
+
+    Local<Value> error = stmt->SyncError();
+    if (!error.IsEmpty()) {
+        return ThrowException(error);
+    }
+
+    RunBaton* baton = stmt->Bind<RunBaton>(args);
+    if (baton == NULL) {
+        return ThrowException(Exception::Error(String::New("Data type is not supported")));
+    }
+
+    sqlite3_mutex* mtx = stmt->SyncLock();
+    if (mtx == NULL) {
+        delete baton;
+        EXCEPTION(String::New("Database is busy"), SQLITE_MISUSE, exception);
+        return ThrowException(exception);
+    }
+    Work_Run(&baton->request);
+    stmt->SyncUnlock(mtx);
+
+    stmt->GroupCommitReport(baton);
+    if (baton->generation && !baton->committed) {
+        stmt->db->GroupDefer(stmt->handle_, Handle<Function>(),
+            baton->inserted_id, baton->changes, baton->generation);
+    }
+
+    if (stmt->status != SQLITE_ROW && stmt->status != SQLITE_DONE) {
+        EXCEPTION(String::New(stmt->message.c_str()), stmt->status, exception);
+        delete baton;
+        return ThrowException(exception);
+    }
+
+    Local<Integer> last_id(Integer::New(baton->inserted_id));
+    Local<Integer> changes(Integer::New(baton->changes));
+    stmt->handle_->Set(String::NewSymbol("lastID"), last_id);
+    stmt->handle_->Set(String::NewSymbol("changes"), changes);
+
+    Local<Object> result = Object::New();
+    result->Set(String::NewSymbol("lastID"), last_id);
+    result->Set(String::NewSymbol("changes"), changes);
+
+    delete baton;
+    return scope.Close(result);
+}
+
+// Statement#allSync([bind1, bind2, ...])
+Handle<Value> Statement::AllSync(const Arguments& args) {
+    HandleScope scope;
+    Statement* stmt = ObjectWrap::Unwrap<Statement>(args.This());
+
+    Local<Value> error = stmt->SyncError();
+    if (!error.IsEmpty()) {
+        return ThrowException(error);
+    }
+
+    RowsBaton* baton = stmt->Bind<RowsBaton>(args);
+    if (baton == NULL) {
+        return ThrowException(Exception::Error(String::New("Data type is not supported")));
+    }
+
+    sqlite3_mutex* mtx = stmt->SyncLock();
+    if (mtx == NULL) {
+        delete baton;
+        EXCEPTION(String::New("Database is busy"), SQLITE_MISUSE, exception);
+        return ThrowException(exception);
+    }
+    Work_All(&baton->request);
+    stmt->SyncUnlock(mtx);
+    stmt->ReportRows(baton);
+
+    if (stmt->status != SQLITE_DONE) {
+        EXCEPTION(String::New(stmt->message.c_str()), stmt->status, exception);
+        delete baton;
+        return ThrowException(exception);
+    }
+
+    size_t length = baton->rows.Length();
+    Local<Array> result(Array::New(length));
+    for (size_t i = 0; i < length; i++) {
+        result->Set(i, stmt->RowToJS(baton->rows, i));
+    }
+
+    delete baton;
+    return scope.Close(result);
+}
+
+Local<Object> Statement::RowToJS(Rows& rows, size_t i) {
+    // Note: Must only be called after SetColumns() received the metadata
+    // matching these rows.
     Local<Object> result(Object::New());
 
-    Row::const_iterator it = row->begin();
-    Row::const_iterator end = row->end();
-    for (int i = 0; it < end; ++it, i++) {
-        Values::Field* field = *it;
+    Rows::Cell* cell = rows.Row(i);
+    int width = rows.Width();
+    assert(width <= (int)column_names.size());
 
+    for (int j = 0; j < width; j++, cell++) {
         Local<Value> value;
 
-        switch (field->type) {
+        switch (cell->type) {
             case SQLITE_INTEGER: {
-                value = Local<Value>(Number::New(((Values::Integer*)field)->value));
+                value = Local<Value>(Number::New(cell->value.integer));
             } break;
             case SQLITE_FLOAT: {
-                value = Local<Value>(Number::New(((Values::Float*)field)->value));
+                value = Local<Value>(Number::New(cell->value.number));
             } break;
             case SQLITE_TEXT: {
-                value = Local<Value>(String::New(((Values::Text*)field)->value.c_str(), ((Values::Text*)field)->value.size()));
+                value = Local<Value>(String::New(rows.Data(cell), cell->length));
             } break;
             case SQLITE_BLOB: {
+                // The Buffer takes over the allocation made on the worker.
+                char* blob = cell->value.blob;
+                cell->value.blob = NULL;
 #if NODE_VERSION_AT_LEAST(0, 11, 3)
-                value = Local<Value>::New(Buffer::New(((Values::Blob*)field)->value, ((Values::Blob*)field)->length));
+                value = Local<Value>::New(Buffer::New(blob, cell->length, FreeBlob, NULL));
 #else
-                value = Local<Value>::New(Buffer::New(((Values::Blob*)field)->value, ((Values::Blob*)field)->length)->handle_);
+                value = Local<Value>::New(Buffer::New(blob, cell->length, FreeBlob, NULL)->handle_);
 #endif
             } break;
             case SQLITE_NULL: {
@@ -769,44 +2045,129 @@ Local<Object> Statement::RowToJS(Row* row) {
             } break;
         }
 
-        result->Set(String::NewSymbol(field->name.c_str()), value);
-
-        DELETE_FIELD(field);
+        result->Set(column_names[j], value);
     }
 
     return result;
 }
 
-void Statement::GetRow(Row* row, sqlite3_stmt* stmt) {
-    int rows = sqlite3_column_count(stmt);
+Statement::Columns* Statement::UpdateColumns() {
+    // Note: This function is called in the thread pool.
+    int count = sqlite3_column_count(handle);
+    bool changed = (count != (int)columns.names.size());
 
-    for (int i = 0; i < rows; i++) {
-        int type = sqlite3_column_type(stmt, i);
-        const char* name = sqlite3_column_name(stmt, i);
-        switch (type) {
+    for (int i = 0; !changed && i < count; i++) {
+        const char* name = sqlite3_column_name(handle, i);
+        const char* type = sqlite3_column_decltype(handle, i);
+        changed = columns.names[i] != name ||
+            columns.types[i] != (type ? type : "");
+    }
+
+    if (!changed) {
+        return NULL;
+    }
+
+    columns.names.clear();
+    columns.types.clear();
+    for (int i = 0; i < count; i++) {
+        const char* type = sqlite3_column_decltype(handle, i);
+        columns.names.push_back(sqlite3_column_name(handle, i));
+        columns.types.push_back(type ? type : "");
+    }
+
+    return new Columns(columns);
+}
+
+void Statement::SetColumns(Columns* metadata) {
+    // Note: This function is called in the main V8 thread.
+    if (metadata == NULL) {
+        return;
+    }
+
+    for (unsigned int i = 0; i < column_names.size(); i++) {
+        column_names[i].Dispose();
+    }
+    column_names.clear();
+
+    for (unsigned int i = 0; i < metadata->names.size(); i++) {
+        const std::string& name = metadata->names[i];
+        column_names.push_back(Persistent<String>::New(
+            String::NewSymbol(name.c_str(), name.size())));
+    }
+}
+
+void Statement::FreeBlob(char* data, void* hint) {
+    free(data);
+}
+
+Rows::~Rows() {
+    Clear();
+}
+
+void Rows::Clear() {
+    for (size_t i = 0, size = cells.size(); i < size; i++) {
+        if (cells[i].type == SQLITE_BLOB) {
+            free(cells[i].value.blob);
+        }
+    }
+    cells.clear();
+    bytes.clear();
+    width = 0;
+    count = 0;
+    size = 0;
+}
+
+size_t Rows::Append(sqlite3_stmt* stmt) {
+    // Note: This function is called in the thread pool.
+    if (count == 0) {
+        width = sqlite3_column_count(stmt);
+    }
+    assert(width == sqlite3_column_count(stmt));
+
+    size_t first = cells.size();
+    size_t before = bytes.size();
+    size_t blobs = 0;
+    cells.resize(first + width);
+    count++;
+
+    for (int i = 0; i < width; i++) {
+        Cell* cell = &cells[first + i];
+        cell->type = sqlite3_column_type(stmt, i);
+        cell->length = 0;
+        switch (cell->type) {
             case SQLITE_INTEGER: {
-                row->push_back(new Values::Integer(name, sqlite3_column_int64(stmt, i)));
+                cell->value.integer = sqlite3_column_int64(stmt, i);
             }   break;
             case SQLITE_FLOAT: {
-                row->push_back(new Values::Float(name, sqlite3_column_double(stmt, i)));
+                cell->value.number = sqlite3_column_double(stmt, i);
             }   break;
             case SQLITE_TEXT: {
                 const char* text = (const char*)sqlite3_column_text(stmt, i);
-                int length = sqlite3_column_bytes(stmt, i);
-                row->push_back(new Values::Text(name, length, text));
+                cell->length = sqlite3_column_bytes(stmt, i);
+                cell->value.offset = bytes.size();
+                bytes.insert(bytes.end(), text, text + cell->length);
             } break;
             case SQLITE_BLOB: {
                 const void* blob = sqlite3_column_blob(stmt, i);
-                int length = sqlite3_column_bytes(stmt, i);
-                row->push_back(new Values::Blob(name, length, blob));
+                cell->length = sqlite3_column_bytes(stmt, i);
+                // Always allocate so that the Buffer has a backing store even
+                // for empty blobs.
+                cell->value.blob = (char*)malloc(cell->length ? cell->length : 1);
+                if (cell->length) {
+                    memcpy(cell->value.blob, blob, cell->length);
+                }
+                blobs += cell->length;
             }   break;
             case SQLITE_NULL: {
-                row->push_back(new Values::Null(name));
             }   break;
             default:
                 assert(false);
         }
     }
+
+    size_t row = width * sizeof(Cell) + (bytes.size() - before) + blobs;
+    size += row;
+    return row;
 }
 
 Handle<Value> Statement::Finalize(const Arguments& args) {
@@ -835,10 +2196,35 @@ void Statement::Finalize() {
     assert(!finalized);
     finalized = true;
     CleanQueue();
-    // Finalize returns the status code of the last operation. We already fired
-    // error events in case those failed.
-    sqlite3_finalize(handle);
+    if (cached && handle != NULL && db->open) {
+        StatementCache::Entry* entry = new StatementCache::Entry();
+        entry->sql = sql;
+        entry->handle = handle;
+        entry->reader = reader;
+        entry->query = query;
+        entry->columns = columns;
+        // The cache now owns the handle.
+        db->statement_cache->Release(entry);
+    }
+    else if (handle != NULL) {
+        // Finalize returns the status code of the last operation. We already
+        // fired error events in case those failed.
+        ConnectionLock lock(db->bridge, connection);
+        sqlite3_finalize(handle);
+    }
     handle = NULL;
+    reader = -1;
+    for (unsigned int i = 0; i < idle.size(); i++) {
+        if (idle[i] != NULL) {
+            ConnectionLock lock(db->bridge, sqlite3_db_handle(idle[i]));
+            sqlite3_finalize(idle[i]);
+        }
+    }
+    idle.clear();
+    for (unsigned int i = 0; i < pins.size(); i++) {
+        pins[i].Dispose();
+    }
+    pins.clear();
     db->Unref();
 }
 
@@ -886,3 +2272,60 @@ void Statement::CleanQueue() {
         delete call;
     }
 }
+
+StatementCache::Entry* StatementCache::Acquire(const std::string& sql) {
+    std::map<std::string, Entries::iterator>::iterator it = index.find(sql);
+    if (it == index.end()) {
+        misses++;
+        return NULL;
+    }
+
+    hits++;
+    Entry* entry = *it->second;
+    entries.erase(it->second);
+    index.erase(it);
+    return entry;
+}
+
+void StatementCache::Release(Entry* entry) {
+    {
+        ConnectionLock lock(db->bridge, sqlite3_db_handle(entry->handle));
+        sqlite3_reset(entry->handle);
+        sqlite3_clear_bindings(entry->handle);
+    }
+
+    if (capacity == 0 || index.find(entry->sql) != index.end()) {
+        // Another statement with the same SQL is already idle.
+        Evict(entry);
+        return;
+    }
+
+    entries.push_front(entry);
+    index[entry->sql] = entries.begin();
+    Resize(capacity);
+}
+
+void StatementCache::Resize(unsigned int capacity_) {
+    capacity = capacity_;
+    while (entries.size() > capacity) {
+        Entry* entry = entries.back();
+        entries.pop_back();
+        index.erase(entry->sql);
+        Evict(entry);
+    }
+}
+
+void StatementCache::Flush() {
+    unsigned int previous = capacity;
+    Resize(0);
+    capacity = previous;
+}
+
+void StatementCache::Evict(Entry* entry) {
+    {
+        ConnectionLock lock(db->bridge, sqlite3_db_handle(entry->handle));
+        sqlite3_finalize(entry->handle);
+    }
+    evictions++;
+    delete entry;
+}
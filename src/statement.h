@@ -5,9 +5,13 @@
 
 #include "database.h"
 #include "threading.h"
+#include "async.h"
 
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
+#include <list>
+#include <map>
 #include <string>
 #include <queue>
 #include <vector>
@@ -51,24 +55,86 @@ namespace Values {
 
     struct Blob : Field {
         template <class T> inline Blob(T _name, size_t len, const void* val) :
-                Field(_name, SQLITE_BLOB), length(len) {
+                Field(_name, SQLITE_BLOB), length(len), pinned(false) {
             value = (char*)malloc(len);
             memcpy(value, val, len);
         }
+        // Refers to the memory of a Buffer that is kept alive by a
+        // persistent handle instead of copying it.
+        template <class T> inline Blob(T _name, size_t len, char* val, bool pinned_) :
+                Field(_name, SQLITE_BLOB), length(len), value(val), pinned(pinned_) {}
         inline ~Blob() {
-            free(value);
+            if (!pinned) free(value);
         }
         int length;
         char* value;
+        bool pinned;
     };
 
     typedef Field Null;
 }
 
-typedef std::vector<Values::Field*> Row;
-typedef std::vector<Row*> Rows;
-typedef Row Parameters;
+typedef std::vector<Values::Field*> Parameters;
+typedef std::vector<Persistent<Object> > Pins;
 
+// Result rows are stored contiguously: one fixed-width cell per column and an
+// appended byte region holding the TEXT values. A whole result set is freed at
+// once when the object is destroyed. BLOB values get their own allocation so
+// that it can become the backing store of a Buffer without another copy.
+class Rows {
+public:
+    struct Cell {
+        int type;
+        int length;
+        union {
+            sqlite3_int64 integer;
+            double number;
+            size_t offset;
+            char* blob;
+        } value;
+    };
+
+    Rows() : width(0), count(0), size(0) {}
+    ~Rows();
+
+    // Copies the current result row of the statement and returns the number
+    // of bytes it occupies.
+    size_t Append(sqlite3_stmt* stmt);
+
+    inline size_t Length() const { return count; }
+    inline bool Empty() const { return count == 0; }
+    inline size_t Size() const { return size; }
+
+    inline Cell* Row(size_t i) { return &cells[i * width]; }
+    inline const Cell* Row(size_t i) const { return &cells[i * width]; }
+    inline int Width() const { return width; }
+    inline const char* Data(const Cell* cell) const {
+        return bytes.empty() ? NULL : &bytes[0] + cell->value.offset;
+    }
+
+    // Drops all rows but keeps the allocated capacity.
+    void Clear();
+
+    inline void Swap(Rows& other) {
+        std::swap(width, other.width);
+        std::swap(count, other.count);
+        std::swap(size, other.size);
+        cells.swap(other.cells);
+        bytes.swap(other.bytes);
+    }
+
+protected:
+    int width;
+    size_t count;
+    size_t size;
+    std::vector<Cell> cells;
+    std::vector<char> bytes;
+
+private:
+    // Cells own their BLOB allocations.
+    Rows(const Rows&);
+    Rows& operator=(const Rows&);
+};
 
 
 class Statement : public ObjectWrap {
@@ -78,13 +144,31 @@ public:
     static void Init(Handle<Object> target);
     static Handle<Value> New(const Arguments& args);
 
+    // Result column metadata. Captured on the worker after preparing and
+    // whenever SQLite re-prepares the statement with a different shape.
+    struct Columns {
+        std::vector<std::string> names;
+        std::vector<std::string> types;
+    };
+
     struct Baton {
         uv_work_t request;
         Statement* stmt;
         Persistent<Function> callback;
         Parameters parameters;
-
-        Baton(Statement* stmt_, Handle<Function> cb_) : stmt(stmt_) {
+        Pins pins;
+        Columns* columns;
+        // uv_hrtime() after which the call is interrupted, or 0.
+        uint64_t deadline;
+        bool timed_out;
+        // Group commit: the implicit transaction that was finished before
+        // the statement ran, if any.
+        unsigned int committed;
+        int commit_status;
+        std::string commit_message;
+
+        Baton(Statement* stmt_, Handle<Function> cb_) : stmt(stmt_), columns(NULL),
+                deadline(0), timed_out(false), committed(0), commit_status(SQLITE_OK) {
             stmt->Ref();
             request.data = this;
             callback = Persistent<Function>::New(cb_);
@@ -94,6 +178,15 @@ public:
                 Values::Field* field = parameters[i];
                 DELETE_FIELD(field);
             }
+            if (!parameters.empty() && !stmt->finalized) {
+                // Binding these parameters cleared the previous bindings, so
+                // the statement only needs to keep this baton's Buffers alive.
+                stmt->pins.swap(pins);
+            }
+            for (unsigned int i = 0; i < pins.size(); i++) {
+                pins[i].Dispose();
+            }
+            delete columns;
             stmt->Unref();
             callback.Dispose();
         }
@@ -102,12 +195,71 @@ public:
     struct RowBaton : Baton {
         RowBaton(Statement* stmt_, Handle<Function> cb_) :
             Baton(stmt_, cb_) {}
-        Row row;
+        Rows row;
     };
 
     struct RunBaton : Baton {
         RunBaton(Statement* stmt_, Handle<Function> cb_) :
-            Baton(stmt_, cb_), inserted_id(0), changes(0) {}
+            Baton(stmt_, cb_), inserted_id(0), changes(0), generation(0) {}
+        sqlite3_int64 inserted_id;
+        int changes;
+        // Group commit: the implicit transaction the write joined.
+        unsigned int generation;
+    };
+
+    struct BatchBaton : Baton {
+        BatchBaton(Statement* stmt_, Handle<Function> cb_) :
+            Baton(stmt_, cb_), transaction(false), aggregate(false),
+            inserted_id(0), changes(0) {}
+        virtual ~BatchBaton() {
+            for (unsigned int i = 0; i < sets.size(); i++) {
+                for (unsigned int j = 0; j < sets[i].size(); j++) {
+                    Values::Field* field = sets[i][j];
+                    DELETE_FIELD(field);
+                }
+            }
+            if (!sets.empty() && !stmt->finalized) {
+                // The statement stays bound to the last parameter set.
+                stmt->pins.swap(pins);
+            }
+        }
+        std::vector<Parameters> sets;
+        bool transaction;
+        bool aggregate;
+        std::vector<sqlite3_int64> inserted_ids;
+        std::vector<int> row_changes;
+        sqlite3_int64 inserted_id;
+        int changes;
+    };
+
+    // A column of Statement#runColumns. Typed arrays are read in place on
+    // the worker; the values of other arrays are converted up front.
+    struct Column {
+        Column() : index(0), data(NULL), type(kExternalDoubleArray) {}
+        int index;
+        std::string name;
+        void* data;
+        ExternalArrayType type;
+        Parameters values;
+    };
+
+    struct ColumnsBaton : Baton {
+        ColumnsBaton(Statement* stmt_, Handle<Function> cb_) :
+            Baton(stmt_, cb_), length(0), inserted_id(0), changes(0) {}
+        virtual ~ColumnsBaton() {
+            for (unsigned int i = 0; i < sources.size(); i++) {
+                for (unsigned int j = 0; j < sources[i].values.size(); j++) {
+                    Values::Field* field = sources[i].values[j];
+                    DELETE_FIELD(field);
+                }
+            }
+            if (!sources.empty() && !stmt->finalized) {
+                // The statement stays bound to the last row.
+                stmt->pins.swap(pins);
+            }
+        }
+        std::vector<Column> sources;
+        size_t length;
         sqlite3_int64 inserted_id;
         int changes;
     };
@@ -118,6 +270,28 @@ public:
         Rows rows;
     };
 
+    struct FetchBaton : RowsBaton {
+        FetchBaton(Statement* stmt_, Handle<Function> cb_, int count_) :
+            RowsBaton(stmt_, cb_), count(count_) {}
+        int count;
+    };
+
+    // Queued calls that are executed back to back in one worker trip. The
+    // status and message of each call are saved so that the callbacks see
+    // their own results.
+    struct PipelineBaton : Baton {
+        struct Item {
+            Baton* baton;
+            uv_work_cb work;
+            void (*after)(uv_work_t* req);
+            int status;
+            std::string message;
+        };
+        PipelineBaton(Statement* stmt_) :
+            Baton(stmt_, Handle<Function>()) {}
+        std::vector<Item> items;
+    };
+
     struct Async;
 
     struct EachBaton : Baton {
@@ -130,11 +304,14 @@ public:
     struct PrepareBaton : Database::Baton {
         Statement* stmt;
         std::string sql;
+        Columns* columns;
+        int reader;
         PrepareBaton(Database* db_, Handle<Function> cb_, Statement* stmt_) :
-            Baton(db_, cb_), stmt(stmt_) {
+            Baton(db_, cb_), stmt(stmt_), columns(NULL), reader(-1) {
             stmt->Ref();
         }
         virtual ~PrepareBaton() {
+            delete columns;
             stmt->Unref();
             if (!db->IsOpen() && db->IsLocked()) {
                 // The database handle was closed before the statement could be
@@ -153,55 +330,112 @@ public:
     };
 
     struct Async {
+        // Rows that the worker hands to the item callbacks in one piece.
+        struct Chunk {
+            Chunk() : columns(NULL) {}
+            ~Chunk() { delete columns; }
+            Rows rows;
+            // Set on the first chunk when the column metadata changed.
+            Columns* columns;
+        };
+
         uv_async_t watcher;
         Statement* stmt;
-        Rows data;
+        // Filled chunks on their way to the main thread, and emptied ones
+        // on their way back to the worker for reuse.
+        Ring<Chunk*> chunks;
+        Ring<Chunk*> spare;
+        volatile unsigned long signaled;
+        volatile unsigned long completed;
+        // Only used when the worker has to wait for the main thread.
         NODE_SQLITE3_MUTEX_t;
-        bool completed;
+        NODE_SQLITE3_COND_t;
         int retrieved;
 
+        // Rows (and their size) that were produced by the worker but not yet
+        // passed to the item callback.
+        volatile unsigned long buffered;
+        volatile unsigned long buffered_bytes;
+        Database::EachLimits limits;
+
         // Store the callbacks here because we don't have
         // access to the baton in the async callback.
         Persistent<Function> item_cb;
         Persistent<Function> completed_cb;
 
         Async(Statement* st, uv_async_cb async_cb) :
-                stmt(st), completed(false), retrieved(0) {
+                stmt(st), chunks(1024), spare(64), signaled(0), completed(0),
+                retrieved(0), buffered(0), buffered_bytes(0),
+                limits(st->db->each_limits) {
             watcher.data = this;
             NODE_SQLITE3_MUTEX_INIT
+            NODE_SQLITE3_COND_INIT
             stmt->Ref();
             uv_async_init(uv_default_loop(), &watcher, async_cb);
         }
 
         ~Async() {
+            Chunk* chunk;
+            while (chunks.pop(chunk)) delete chunk;
+            while (spare.pop(chunk)) delete chunk;
             stmt->Unref();
             item_cb.Dispose();
             completed_cb.Dispose();
+            NODE_SQLITE3_COND_DESTROY
             NODE_SQLITE3_MUTEX_DESTROY
         }
+
+        // Worker side.
+        Chunk* Take();
+        void Push(Chunk* chunk);
+        bool Full();
+        void Park();
+        void Wake();
+        // Main thread side.
+        void Return(Chunk* chunk);
     };
 
     Statement(Database* db_) : ObjectWrap(),
             db(db_),
+            connection(NULL),
+            reader(-1),
+            query(false),
             handle(NULL),
             status(SQLITE_OK),
             prepared(false),
             locked(true),
-            finalized(false) {
+            finalized(false),
+            pipelined(false),
+            cached(false),
+            pinned(false) {
+        NODE_SQLITE3_MUTEX_INIT
         db->Ref();
     }
 
     ~Statement() {
         if (!finalized) Finalize();
+        for (unsigned int i = 0; i < column_names.size(); i++) {
+            column_names[i].Dispose();
+        }
+        NODE_SQLITE3_MUTEX_DESTROY
     }
 
     WORK_DEFINITION(Bind);
     WORK_DEFINITION(Get);
     WORK_DEFINITION(Run);
+    WORK_DEFINITION(RunBatch);
+    WORK_DEFINITION(RunColumns);
     WORK_DEFINITION(All);
     WORK_DEFINITION(Each);
+    WORK_DEFINITION(Fetch);
     WORK_DEFINITION(Reset);
 
+    static Handle<Value> GetSync(const Arguments& args);
+    static Handle<Value> RunSync(const Arguments& args);
+    static Handle<Value> AllSync(const Arguments& args);
+
+    static Handle<Value> Status(const Arguments& args);
+
     static Handle<Value> Finalize(const Arguments& args);
 
 protected:
@@ -209,18 +443,49 @@ protected:
     static void Work_Prepare(uv_work_t* req);
     static void Work_AfterPrepare(uv_work_t* req);
 
+    static void Work_BeginPipeline(Baton* baton);
+    static void Work_Pipeline(uv_work_t* req);
+    static void Work_AfterPipeline(uv_work_t* req);
+    bool Pipeline(Call* call);
+    static bool PipelineItem(Call* call, PipelineBaton::Item& item);
+
     static void AsyncEach(uv_async_t* handle, int status);
     static void CloseCallback(uv_handle_t* handle);
 
     static void Finalize(Baton* baton);
     void Finalize();
 
-    template <class T> inline Values::Field* BindParameter(const Handle<Value> source, T pos);
+    bool Prepare(const std::string& sql);
+    bool IsQuery();
+    int Route(bool resets, bool rebinds);
+    bool Move(int target);
+    Local<Value> SyncError();
+    sqlite3_mutex* SyncLock();
+    void SyncUnlock(sqlite3_mutex* mtx);
+
+    template <class T> inline Values::Field* BindParameter(const Handle<Value> source, T pos, Baton* baton);
+    void BindSet(const Local<Value> source, Parameters& parameters, Baton* baton);
     template <class T> T* Bind(const Arguments& args, int start = 0, int end = -1);
     bool Bind(const Parameters parameters);
+    int BindValue(int pos, Values::Field* field);
+    int BindColumn(const Column& column, size_t row);
+
+    static int TimeoutHandler(void* baton);
+    void BeginTimeout(Baton* baton);
+    void EndTimeout(Baton* baton);
 
-    static void GetRow(Row* row, sqlite3_stmt* stmt);
-    static Local<Object> RowToJS(Row* row);
+    void GroupCommitBefore(Baton* baton);
+    void GroupCommitReport(Baton* baton);
+    void ReportRows(Baton* baton);
+    void Committed();
+    size_t UpdateMark();
+    void UpdateUndo(size_t mark);
+
+    Columns* UpdateColumns();
+    void SetColumns(Columns* columns);
+
+    Local<Object> RowToJS(Rows& rows, size_t i);
+    static void FreeBlob(char* data, void* hint);
     void Schedule(Work_Callback callback, Baton* baton);
     void Process();
     void CleanQueue();
@@ -228,6 +493,19 @@ protected:
 
 protected:
     Database* db;
+    // The connection the handle was prepared on: either the primary
+    // connection of db or one of its readers.
+    sqlite3* connection;
+    int reader;
+    // Set for queries, which are moved between the readers and the primary
+    // connection per execution. Handles on the connections the statement
+    // doesn't currently use are kept in idle, at the reader's index + 1 or
+    // at 0 for the primary connection.
+    bool query;
+    std::vector<sqlite3_stmt*> idle;
+    // Held by Move while it swaps handle and idle, so that the main thread
+    // can read the counters of all handles while a call runs.
+    NODE_SQLITE3_MUTEX_t
 
     sqlite3_stmt* handle;
     int status;
@@ -237,6 +515,70 @@ protected:
     bool locked;
     bool finalized;
     std::queue<Call*> queue;
+    // Set while the callbacks of a pipeline are fired.
+    bool pipelined;
+
+    // The handle is taken from and returned to the database's statement
+    // cache, keyed by this SQL text.
+    bool cached;
+    std::string sql;
+    // Set while a synchronous call runs, which stays on the connection
+    // SyncLock picked.
+    bool pinned;
+
+    // Buffers referenced by the current bindings with SQLITE_STATIC.
+    Pins pins;
+
+    // Column metadata as last seen by the worker thread.
+    Columns columns;
+    // Column names interned as symbols; only touched on the main thread.
+    std::vector<Persistent<String> > column_names;
+};
+
+// Idle prepared statements keyed by their SQL text, least recently used
+// first out. Statements are reset and their bindings cleared when they are
+// returned. SQLite re-prepares them transparently after schema changes, and
+// the column metadata is checked again when the first row is retrieved.
+// Only used on the main thread.
+class StatementCache {
+public:
+    struct Entry {
+        std::string sql;
+        sqlite3_stmt* handle;
+        int reader;
+        bool query;
+        Statement::Columns columns;
+    };
+
+    StatementCache(Database* db_) : hits(0), misses(0), evictions(0),
+        db(db_), capacity(0) {}
+    ~StatementCache() { Flush(); }
+
+    // Removes an idle statement for sql from the cache. The caller owns the
+    // returned entry. Returns NULL on a miss.
+    Entry* Acquire(const std::string& sql);
+    // Takes ownership of the entry and evicts the least recently used
+    // statements when the cache is full.
+    void Release(Entry* entry);
+    void Resize(unsigned int capacity);
+    void Flush();
+
+    inline unsigned int Capacity() const { return capacity; }
+    inline unsigned int Size() const { return index.size(); }
+
+    double hits;
+    double misses;
+    double evictions;
+
+protected:
+    typedef std::list<Entry*> Entries;
+
+    void Evict(Entry* entry);
+
+    Database* db;
+    unsigned int capacity;
+    Entries entries;
+    std::map<std::string, Entries::iterator> index;
 };
 
 }
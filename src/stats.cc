@@ -0,0 +1,164 @@
+#include <ctype.h>
+#include <math.h>
+
+#include "stats.h"
+
+using namespace node_sqlite3;
+
+void Histogram::Record(sqlite3_uint64 value) {
+    counts[Index(value)]++;
+    count++;
+    total += value;
+    if (value > max) max = value;
+}
+
+sqlite3_uint64 Histogram::Percentile(double quantile) const {
+    if (count == 0) return 0;
+
+    sqlite3_uint64 rank = (sqlite3_uint64)ceil(quantile * (double)count);
+    if (rank < 1) rank = 1;
+
+    sqlite3_uint64 seen = 0;
+    for (int i = 0; i < bucket_count; i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            sqlite3_uint64 highest = Highest(i);
+            return highest < max ? highest : max;
+        }
+    }
+    return max;
+}
+
+int Histogram::Index(sqlite3_uint64 value) {
+    if (value < (sqlite3_uint64)sub_count) return (int)value;
+
+    int msb = sub_bits;
+    while (msb < 63 && (value >> (msb + 1)) != 0) msb++;
+
+    int shift = msb - sub_bits;
+    int index = sub_count + shift * sub_count +
+        (int)((value >> shift) - sub_count);
+    return index < bucket_count ? index : bucket_count - 1;
+}
+
+sqlite3_uint64 Histogram::Highest(int index) {
+    if (index < sub_count) return (sqlite3_uint64)index;
+
+    int shift = (index - sub_count) / sub_count;
+    int sub = (index - sub_count) % sub_count;
+    sqlite3_uint64 lowest = (sqlite3_uint64)(sub_count + sub) << shift;
+    return lowest + ((sqlite3_uint64)1 << shift) - 1;
+}
+
+QueryStats::QueryStats() {
+    NODE_SQLITE3_MUTEX_INIT
+}
+
+QueryStats::~QueryStats() {
+    Clear();
+    NODE_SQLITE3_MUTEX_DESTROY
+}
+
+void QueryStats::Clear() {
+    Histograms::iterator it = histograms.begin();
+    for (; it != histograms.end(); ++it) {
+        delete it->second;
+    }
+    histograms.clear();
+}
+
+std::string QueryStats::Normalize(const char* sql) {
+    std::string result;
+    bool space = false;
+    const char* p = sql;
+
+    while (*p) {
+        unsigned char c = *p;
+        if (isspace(c)) {
+            space = true;
+            p++;
+            continue;
+        }
+        if (space && !result.empty()) result += ' ';
+        space = false;
+
+        if (c == '\'') {
+            // String literal; '' is an escaped quote.
+            for (p++; *p; p++) {
+                if (*p == '\'') {
+                    if (p[1] != '\'') { p++; break; }
+                    p++;
+                }
+            }
+            result += '?';
+        }
+        else if (isdigit(c) && (result.empty() ||
+                !(isalnum((unsigned char)result[result.size() - 1]) ||
+                  result[result.size() - 1] == '_'))) {
+            // Number literal, including hex and exponent notation.
+            for (p++; *p; p++) {
+                unsigned char d = *p;
+                if ((d == '+' || d == '-') && (p[-1] == 'e' || p[-1] == 'E')) continue;
+                if (!isalnum(d) && d != '.') break;
+            }
+            result += '?';
+        }
+        else {
+            result += c;
+            p++;
+        }
+    }
+
+    return result;
+}
+
+void QueryStats::Record(const char* sql, sqlite3_uint64 nsecs) {
+    // Note: This function is called in the thread pool.
+    std::string key = Normalize(sql);
+
+    NODE_SQLITE3_MUTEX_LOCK(&mutex)
+    Histograms::iterator it = histograms.find(key);
+    Histogram* histogram;
+    if (it != histograms.end()) {
+        histogram = it->second;
+    }
+    else {
+        if (histograms.size() >= max_queries) {
+            key = "(other)";
+            it = histograms.find(key);
+        }
+        if (it != histograms.end()) {
+            histogram = it->second;
+        }
+        else {
+            histogram = new Histogram();
+            histograms[key] = histogram;
+        }
+    }
+    histogram->Record(nsecs / 1000);
+    NODE_SQLITE3_MUTEX_UNLOCK(&mutex)
+}
+
+Local<Object> QueryStats::Snapshot(bool reset) {
+    HandleScope scope;
+    Local<Object> result = Object::New();
+
+    NODE_SQLITE3_MUTEX_LOCK(&mutex)
+    Histograms::const_iterator it = histograms.begin();
+    for (; it != histograms.end(); ++it) {
+        const Histogram* histogram = it->second;
+        Local<Object> entry = Object::New();
+        entry->Set(String::NewSymbol("count"), Number::New((double)histogram->count));
+        entry->Set(String::NewSymbol("mean"), Number::New(
+            (double)histogram->total / (double)histogram->count / 1000.0));
+        entry->Set(String::NewSymbol("p50"), Number::New(histogram->Percentile(0.50) / 1000.0));
+        entry->Set(String::NewSymbol("p95"), Number::New(histogram->Percentile(0.95) / 1000.0));
+        entry->Set(String::NewSymbol("p99"), Number::New(histogram->Percentile(0.99) / 1000.0));
+        entry->Set(String::NewSymbol("max"), Number::New(histogram->max / 1000.0));
+        result->Set(String::New(it->first.c_str(), it->first.size()), entry);
+    }
+    if (reset) Clear();
+    NODE_SQLITE3_MUTEX_UNLOCK(&mutex)
+
+    return scope.Close(result);
+}
@@ -0,0 +1,73 @@
+#ifndef NODE_SQLITE3_SRC_STATS_H
+#define NODE_SQLITE3_SRC_STATS_H
+
+#include <node.h>
+
+#include "threading.h"
+
+#include <map>
+#include <string>
+
+#include <sqlite3.h>
+
+using namespace v8;
+using namespace node;
+
+namespace node_sqlite3 {
+
+// Latency histogram with logarithmic buckets that are split into 16 linear
+// sub-buckets each, so that every recorded value is within 1/16 of its
+// bucket's bounds. Values are in microseconds.
+struct Histogram {
+    static const int sub_bits = 4;
+    static const int sub_count = 1 << sub_bits;
+    // Covers values up to 2^40 microseconds.
+    static const int bucket_count = sub_count + (40 - sub_bits) * sub_count;
+
+    Histogram() : count(0), total(0), max(0) {
+        for (int i = 0; i < bucket_count; i++) counts[i] = 0;
+    }
+
+    void Record(sqlite3_uint64 value);
+    // Returns the highest value of the bucket that holds the given quantile.
+    sqlite3_uint64 Percentile(double quantile) const;
+
+    static int Index(sqlite3_uint64 value);
+    static sqlite3_uint64 Highest(int index);
+
+    sqlite3_uint64 count;
+    sqlite3_uint64 total;
+    sqlite3_uint64 max;
+    unsigned int counts[bucket_count];
+};
+
+// Timings of all statements of a database by their normalized SQL text.
+// Recorded by the profile hook on the worker threads and read with
+// Database#stats on the main thread.
+class QueryStats {
+public:
+    QueryStats();
+    ~QueryStats();
+
+    void Record(const char* sql, sqlite3_uint64 nsecs);
+    Local<Object> Snapshot(bool reset);
+
+    // Replaces literals with "?" and collapses whitespace so that statements
+    // that only differ in their constants share a histogram.
+    static std::string Normalize(const char* sql);
+
+    // Statements beyond this number of distinct texts are counted together.
+    static const size_t max_queries = 1000;
+
+protected:
+    typedef std::map<std::string, Histogram*> Histograms;
+
+    void Clear();
+
+    NODE_SQLITE3_MUTEX_t
+    Histograms histograms;
+};
+
+}
+
+#endif
@@ -16,9 +16,23 @@
 
     #define NODE_SQLITE3_MUTEX_DESTROY CloseHandle(mutex);
 
+    #define NODE_SQLITE3_COND_t HANDLE cond;
+
+    #define NODE_SQLITE3_COND_INIT cond = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+    #define NODE_SQLITE3_COND_WAIT(c, m) SignalObjectAndWait(*m, *c, INFINITE, FALSE); WaitForSingleObject(*m, INFINITE);
+
+    #define NODE_SQLITE3_COND_TIMEDWAIT(c, m, ms) SignalObjectAndWait(*m, *c, (ms), FALSE); WaitForSingleObject(*m, INFINITE);
+
+    #define NODE_SQLITE3_COND_SIGNAL(c) SetEvent(*c);
+
+    #define NODE_SQLITE3_COND_DESTROY CloseHandle(cond);
+
 #elif defined(NODE_SQLITE3_BOOST_THREADING)
 
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 
     #define NODE_SQLITE3_MUTEX_t boost::mutex mutex;
 
@@ -30,8 +44,22 @@
 
     #define NODE_SQLITE3_MUTEX_DESTROY mutex.unlock();
 
+    #define NODE_SQLITE3_COND_t boost::condition_variable_any cond;
+
+    #define NODE_SQLITE3_COND_INIT
+
+    #define NODE_SQLITE3_COND_WAIT(c, m) (*c).wait(*m);
+
+    #define NODE_SQLITE3_COND_TIMEDWAIT(c, m, ms) (*c).timed_wait(*m, boost::posix_time::milliseconds(ms));
+
+    #define NODE_SQLITE3_COND_SIGNAL(c) (*c).notify_one();
+
+    #define NODE_SQLITE3_COND_DESTROY
+
 #else
 
+#include <sys/time.h>
+
     #define NODE_SQLITE3_MUTEX_t pthread_mutex_t mutex;
 
     #define NODE_SQLITE3_MUTEX_INIT pthread_mutex_init(&mutex,NULL);
@@ -42,6 +70,62 @@
 
     #define NODE_SQLITE3_MUTEX_DESTROY pthread_mutex_destroy(&mutex);
 
+    #define NODE_SQLITE3_COND_t pthread_cond_t cond;
+
+    #define NODE_SQLITE3_COND_INIT pthread_cond_init(&cond,NULL);
+
+    #define NODE_SQLITE3_COND_WAIT(c, m) pthread_cond_wait(c, m);
+
+    #define NODE_SQLITE3_COND_TIMEDWAIT(c, m, ms) {                             \
+        struct timeval now;                                                    \
+        gettimeofday(&now, NULL);                                              \
+        struct timespec until;                                                 \
+        until.tv_sec = now.tv_sec + (ms) / 1000;                               \
+        until.tv_nsec = now.tv_usec * 1000 + ((ms) % 1000) * 1000000;          \
+        if (until.tv_nsec >= 1000000000) {                                     \
+            until.tv_sec++;                                                    \
+            until.tv_nsec -= 1000000000;                                       \
+        }                                                                      \
+        pthread_cond_timedwait(c, m, &until);                                  \
+    }
+
+    #define NODE_SQLITE3_COND_SIGNAL(c) pthread_cond_signal(c);
+
+    #define NODE_SQLITE3_COND_DESTROY pthread_cond_destroy(&cond);
+
+#endif
+
+
+// Atomic operations on an unsigned long. Each one is a full memory barrier.
+#ifdef _WIN32
+
+    #define NODE_SQLITE3_ATOMIC_CAS(p, o, n) \
+        (InterlockedCompareExchange((volatile LONG*)(p), (LONG)(n), (LONG)(o)) == (LONG)(o))
+
+    #define NODE_SQLITE3_ATOMIC_ADD(p, v) InterlockedExchangeAdd((volatile LONG*)(p), (LONG)(v));
+
+    #define NODE_SQLITE3_ATOMIC_SUB(p, v) InterlockedExchangeAdd((volatile LONG*)(p), -(LONG)(v));
+
+    #define NODE_SQLITE3_MEMORY_BARRIER MemoryBarrier();
+
+#else
+
+    #define NODE_SQLITE3_ATOMIC_CAS(p, o, n) __sync_bool_compare_and_swap((p), (o), (n))
+
+    #define NODE_SQLITE3_ATOMIC_ADD(p, v) __sync_fetch_and_add((p), (v));
+
+    #define NODE_SQLITE3_ATOMIC_SUB(p, v) __sync_fetch_and_sub((p), (v));
+
+    #define NODE_SQLITE3_MEMORY_BARRIER __sync_synchronize();
+
+#endif
+
+
+// Storage class of variables that every thread has its own copy of.
+#ifdef _WIN32
+    #define NODE_SQLITE3_THREAD_LOCAL __declspec(thread)
+#else
+    #define NODE_SQLITE3_THREAD_LOCAL __thread
 #endif
 
 
@@ -0,0 +1,127 @@
+#include <node.h>
+#include <node_version.h>
+
+#include "worker.h"
+
+using namespace node_sqlite3;
+
+std::map<std::string, Worker*> Worker::groups;
+
+Worker* Worker::Acquire(const std::string& group) {
+    Worker* worker = NULL;
+    if (!group.empty()) {
+        std::map<std::string, Worker*>::iterator it = groups.find(group);
+        if (it != groups.end()) worker = it->second;
+    }
+
+    if (worker == NULL) {
+        worker = new Worker(group);
+        if (!group.empty()) groups[group] = worker;
+    }
+
+    worker->refs++;
+    return worker;
+}
+
+Worker::Worker(const std::string& group_) :
+        group(group_), refs(0), pending(0), stopping(false) {
+    watcher.data = this;
+    NODE_SQLITE3_MUTEX_INIT
+    NODE_SQLITE3_COND_INIT
+    uv_async_init(uv_default_loop(), &watcher, Complete);
+    // An idle worker doesn't keep the process alive.
+#if NODE_VERSION_AT_LEAST(0, 7, 9)
+    uv_unref((uv_handle_t *)&watcher);
+#else
+    uv_unref(uv_default_loop());
+#endif
+    int status = uv_thread_create(&thread, Run, this);
+    assert(status == 0);
+}
+
+Worker::~Worker() {
+    NODE_SQLITE3_COND_DESTROY
+    NODE_SQLITE3_MUTEX_DESTROY
+}
+
+void Worker::Release() {
+    assert(refs > 0);
+    if (--refs > 0) return;
+
+    if (!group.empty()) groups.erase(group);
+
+    NODE_SQLITE3_MUTEX_LOCK(&mutex)
+    stopping = true;
+    NODE_SQLITE3_COND_SIGNAL(&cond)
+    NODE_SQLITE3_MUTEX_UNLOCK(&mutex)
+
+    // No database uses this worker anymore, so its queue is empty and the
+    // thread exits right away.
+    uv_thread_join(&thread);
+    uv_close((uv_handle_t*)&watcher, Close);
+}
+
+void Worker::Queue(uv_work_t* req, uv_work_cb work, uv_after_work_cb after) {
+    assert(!stopping);
+    if (pending++ == 0) {
+#if NODE_VERSION_AT_LEAST(0, 7, 9)
+        uv_ref((uv_handle_t *)&watcher);
+#else
+        uv_ref(uv_default_loop());
+#endif
+    }
+
+    NODE_SQLITE3_MUTEX_LOCK(&mutex)
+    jobs.push(Job(req, work, (After_Callback)after));
+    NODE_SQLITE3_COND_SIGNAL(&cond)
+    NODE_SQLITE3_MUTEX_UNLOCK(&mutex)
+}
+
+void Worker::Run(void* data) {
+    Worker* worker = static_cast<Worker*>(data);
+
+    NODE_SQLITE3_MUTEX_LOCK(&worker->mutex)
+    while (true) {
+        while (worker->jobs.empty() && !worker->stopping) {
+            NODE_SQLITE3_COND_WAIT(&worker->cond, &worker->mutex)
+        }
+        if (worker->jobs.empty()) break;
+
+        Job job = worker->jobs.front();
+        worker->jobs.pop();
+        NODE_SQLITE3_MUTEX_UNLOCK(&worker->mutex)
+
+        job.work(job.req);
+
+        NODE_SQLITE3_MUTEX_LOCK(&worker->mutex)
+        worker->done.push_back(job);
+        uv_async_send(&worker->watcher);
+    }
+    NODE_SQLITE3_MUTEX_UNLOCK(&worker->mutex)
+}
+
+void Worker::Complete(uv_async_t* handle, int status) {
+    Worker* worker = static_cast<Worker*>(handle->data);
+
+    std::vector<Job> completed;
+    NODE_SQLITE3_MUTEX_LOCK(&worker->mutex)
+    completed.swap(worker->done);
+    NODE_SQLITE3_MUTEX_UNLOCK(&worker->mutex)
+
+    for (unsigned int i = 0; i < completed.size(); i++) {
+        if (--worker->pending == 0) {
+#if NODE_VERSION_AT_LEAST(0, 7, 9)
+            uv_unref((uv_handle_t *)&worker->watcher);
+#else
+            uv_unref(uv_default_loop());
+#endif
+        }
+        // The callback may release the worker; it is only deleted once the
+        // watcher is closed.
+        completed[i].after(completed[i].req);
+    }
+}
+
+void Worker::Close(uv_handle_t* handle) {
+    delete static_cast<Worker*>(handle->data);
+}
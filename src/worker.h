@@ -0,0 +1,66 @@
+#ifndef NODE_SQLITE3_SRC_WORKER_H
+#define NODE_SQLITE3_SRC_WORKER_H
+
+#include <node.h>
+
+#include <map>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "threading.h"
+
+namespace node_sqlite3 {
+
+// A native thread with its own job queue. Databases that are opened with the
+// thread option run their work here instead of in the libuv threadpool, so
+// that slow queries and file system work don't hold up each other. Completed
+// jobs are handed back to the main thread with a uv_async.
+class Worker {
+public:
+    // Returns the worker of the named group and creates it if necessary. An
+    // empty group name always creates a new worker.
+    static Worker* Acquire(const std::string& group);
+    void Release();
+
+    void Queue(uv_work_t* req, uv_work_cb work, uv_after_work_cb after);
+
+protected:
+    typedef void (*After_Callback)(uv_work_t* req);
+
+    struct Job {
+        Job(uv_work_t* req_, uv_work_cb work_, After_Callback after_) :
+            req(req_), work(work_), after(after_) {}
+        uv_work_t* req;
+        uv_work_cb work;
+        After_Callback after;
+    };
+
+    Worker(const std::string& group);
+    ~Worker();
+
+    static void Run(void* data);
+    static void Complete(uv_async_t* handle, int status);
+    static void Close(uv_handle_t* handle);
+
+protected:
+    std::string group;
+    unsigned int refs;
+    // Jobs whose after callback hasn't run yet; only touched on the main
+    // thread.
+    unsigned int pending;
+
+    uv_thread_t thread;
+    uv_async_t watcher;
+    NODE_SQLITE3_MUTEX_t
+    NODE_SQLITE3_COND_t
+    bool stopping;
+    std::queue<Job> jobs;
+    std::vector<Job> done;
+
+    static std::map<std::string, Worker*> groups;
+};
+
+}
+
+#endif
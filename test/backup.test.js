@@ -0,0 +1,92 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+var helper = require('./support/helper');
+
+describe('backup', function() {
+    var db;
+    before(function(done) {
+        helper.ensureExists('test/tmp');
+        helper.deleteFile('test/tmp/test_backup.db');
+        db = new sqlite3.Database(':memory:');
+        db.serialize(function() {
+            db.run("CREATE TABLE foo (id INT, txt TEXT)");
+            var stmt = db.prepare("INSERT INTO foo VALUES(?, ?)");
+            for (var i = 0; i < 2000; i++) {
+                stmt.run(i, new Array(200).join('x'));
+            }
+            stmt.finalize(done);
+        });
+    });
+
+    it('should copy the database step by step', function(done) {
+        var progress = [];
+        var queried = false;
+        db.backup('test/tmp/test_backup.db', { pagesPerStep: 10, sleepMs: 1 }, function(err) {
+            if (err) throw err;
+            assert.ok(progress.length > 1);
+            assert.equal(progress[progress.length - 1].remaining, 0);
+            assert.ok(queried);
+
+            var copy = new sqlite3.Database('test/tmp/test_backup.db', sqlite3.OPEN_READONLY);
+            copy.get("SELECT COUNT(*) AS count FROM foo", function(err, row) {
+                if (err) throw err;
+                assert.equal(row.count, 2000);
+                copy.close(done);
+            });
+        }).on('progress', function(info) {
+            assert.ok(info.total > 0);
+            assert.ok(info.remaining <= info.total);
+            progress.push(info);
+        });
+
+        // Queries run while the backup is in progress.
+        db.get("SELECT COUNT(*) AS count FROM foo", function(err, row) {
+            if (err) throw err;
+            assert.equal(row.count, 2000);
+            queried = true;
+        });
+    });
+
+    it('should not step while an exclusive call runs', function(done) {
+        var executing = false;
+        var steps = 0;
+        db.backup('test/tmp/test_backup.db', { pagesPerStep: 5, sleepMs: 0 }, function(err) {
+            if (err) throw err;
+            done();
+        }).on('progress', function() {
+            if (executing) {
+                // Only the step that was running when exec was called.
+                assert.ok(++steps <= 1);
+            }
+            else if (steps === 0) {
+                executing = true;
+                db.exec("SELECT COUNT(*) FROM foo a, foo b WHERE a.id = b.id", function(err) {
+                    if (err) throw err;
+                    executing = false;
+                    steps = 2;
+                });
+            }
+        });
+    });
+
+    it('should report errors', function(done) {
+        db.backup('test/tmp/missing/dir/backup.db', function(err) {
+            assert.ok(err);
+            assert.equal(err.code, 'SQLITE_CANTOPEN');
+            done();
+        });
+    });
+
+    it('should wait for backups before closing', function(done) {
+        var finished = false;
+        db.backup('test/tmp/test_backup.db', { pagesPerStep: 5, sleepMs: 1 }, function(err) {
+            if (err) throw err;
+            finished = true;
+        });
+        db.close(function(err) {
+            if (err) throw err;
+            assert.ok(finished);
+            done();
+        });
+    });
+});
@@ -52,3 +52,41 @@ describe('blob', function() {
         });
     });
 });
+
+describe('pinned blobs', function() {
+    var db;
+    before(function(done) {
+        db = new sqlite3.Database(':memory:');
+        db.configure('pinBuffers', true);
+        db.run("CREATE TABLE elmos (id INT, image BLOB)", done);
+    });
+
+    it('should insert and retrieve pinned blobs', function(done) {
+        db.run('INSERT INTO elmos (id, image) VALUES (?, ?)', 1, elmo, function(err) {
+            if (err) throw err;
+            db.get('SELECT image FROM elmos WHERE id = 1', function(err, row) {
+                if (err) throw err;
+                assert.ok(Buffer.isBuffer(row.image));
+                assert.equal(row.image.length, elmo.length);
+                assert.equal(row.image.toString('base64'), elmo.toString('base64'));
+                done();
+            });
+        });
+    });
+
+    it('should keep bound blobs alive across runs', function(done) {
+        var stmt = db.prepare('INSERT INTO elmos (id, image) VALUES (2, ?)');
+        stmt.bind(new Buffer('pinned'));
+        stmt.run();
+        stmt.run();
+        stmt.finalize(function() {
+            db.all('SELECT image FROM elmos WHERE id = 2', function(err, rows) {
+                if (err) throw err;
+                assert.equal(rows.length, 2);
+                assert.equal(rows[0].image.toString(), 'pinned');
+                assert.equal(rows[1].image.toString(), 'pinned');
+                done();
+            });
+        });
+    });
+});
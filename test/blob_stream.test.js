@@ -0,0 +1,150 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+var Writable = require('stream').Writable;
+
+if (Writable) describe('blob stream', function() {
+    var db;
+    var size = 300000;
+    before(function(done) {
+        db = new sqlite3.Database(':memory:');
+        db.serialize(function() {
+            db.run('CREATE TABLE files (id INTEGER PRIMARY KEY, data BLOB)');
+            db.run('INSERT INTO files VALUES (1, zeroblob(?))', size, done);
+        });
+    });
+
+    it('should write a value in chunks', function(done) {
+        var stream = db.openBlob('files', 'data', 1, { writable: true });
+        stream.on('error', done);
+        stream.on('close', done);
+        for (var i = 0; i < size / 1000; i++) {
+            var chunk = new Buffer(1000);
+            chunk.fill(i % 256);
+            stream.write(chunk);
+        }
+        stream.end();
+    });
+
+    it('should read the value back in chunks', function(done) {
+        var stream = db.openBlob('files', 'data', 1, { chunkSize: 4096 });
+        var chunks = 0;
+        var received = 0;
+        stream.on('open', function(length) {
+            assert.equal(length, size);
+        });
+        stream.on('data', function(chunk) {
+            assert.ok(chunk.length <= 4096);
+            for (var i = 0; i < chunk.length; i++) {
+                assert.equal(chunk[i], Math.floor((received + i) / 1000) % 256);
+            }
+            received += chunk.length;
+            chunks++;
+        });
+        stream.on('end', function() {
+            assert.equal(received, size);
+            assert.equal(chunks, Math.ceil(size / 4096));
+        });
+        stream.on('close', done);
+    });
+
+    it('should start reading at an offset', function(done) {
+        var stream = db.openBlob('files', 'data', 1, { start: size - 10 });
+        var received = 0;
+        stream.on('data', function(chunk) { received += chunk.length; });
+        stream.on('end', function() {
+            assert.equal(received, 10);
+            done();
+        });
+    });
+
+    it('should not grow the value', function(done) {
+        var stream = db.openBlob('files', 'data', 1, { writable: true, start: size - 1 });
+        stream.on('error', function(err) {
+            assert.equal(err.code, 'SQLITE_ERROR');
+            done();
+        });
+        stream.end(new Buffer(2));
+    });
+
+    it('should report a missing row', function(done) {
+        var stream = db.openBlob('files', 'data', 2);
+        stream.on('error', function(err) {
+            assert.ok(/no such rowid/.test(err.message));
+            done();
+        });
+        stream.resume();
+    });
+
+    it('should throw when an operation is in progress', function(done) {
+        var blob = new sqlite3.Blob(db, 'files', 'data', 1, false, function(err) {
+            if (err) return done(err);
+            assert.equal(this.length, size);
+            blob.read(0, 10, function(err) {
+                if (err) return done(err);
+                blob.close(done);
+            });
+            assert.throws(function() {
+                blob.read(10, 10);
+            }, /Blob is busy/);
+        });
+    });
+
+    it('should start the next operation from a callback', function(done) {
+        var blob = new sqlite3.Blob(db, 'files', 'data', 1, false, function(err) {
+            if (err) return done(err);
+            blob.read(0, 10, function(err, first) {
+                if (err) return done(err);
+                blob.read(10, 10, function(err, second) {
+                    if (err) return done(err);
+                    assert.equal(first.length + second.length, 20);
+                    blob.close(done);
+                });
+            });
+        });
+    });
+
+    it('should close a stream while a read is in progress', function(done) {
+        var stream = db.openBlob('files', 'data', 1, { chunkSize: 16 });
+        stream.on('open', function() {
+            stream.resume();
+            stream.close();
+        });
+        stream.on('close', done);
+    });
+
+    it('should keep blob calls in serialized order', function(done) {
+        var blob = new sqlite3.Blob(db, 'files', 'data', 1, true, function(err) {
+            if (err) return done(err);
+            db.serialize(function() {
+                blob.write(0, new Buffer([ 7 ]));
+                db.get('SELECT substr(data, 1, 1) AS first FROM files WHERE id = 1', function(err, row) {
+                    if (err) return done(err);
+                    assert.equal(row.first[0], 7);
+                    blob.close(done);
+                });
+            });
+        });
+    });
+
+    it('should close open blobs with the database', function(done) {
+        var other = new sqlite3.Database(':memory:');
+        other.serialize(function() {
+            other.run('CREATE TABLE files (id INTEGER PRIMARY KEY, data BLOB)');
+            other.run('INSERT INTO files VALUES (1, zeroblob(10))');
+        });
+        var blob = new sqlite3.Blob(other, 'files', 'data', 1, true, function(err) {
+            if (err) return done(err);
+            other.close(function(err) {
+                if (err) return done(err);
+                assert.throws(function() {
+                    blob.read(0, 10);
+                }, /Blob is closed/);
+                done();
+            });
+        });
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
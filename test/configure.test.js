@@ -0,0 +1,68 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+var exec = require('child_process').exec;
+
+// Runs a script in a new process, where SQLite isn't initialized yet.
+function script(source, callback) {
+    var command = JSON.stringify(process.execPath) + ' -e ' + JSON.stringify(
+        "var sqlite3 = require('./lib/sqlite3');" + source);
+    exec(command, function(err, stdout, stderr) {
+        callback(err, stdout.trim(), stderr);
+    });
+}
+
+describe('configure', function() {
+    it('should reject invalid options', function() {
+        assert.throws(function() {
+            sqlite3.configure();
+        }, /Argument 0 must be an object/);
+        assert.throws(function() {
+            sqlite3.configure({ allocator: 'tcmalloc' });
+        }, /allocator must be pool or system/);
+        assert.throws(function() {
+            sqlite3.configure({ pageCache: { pageSize: 1000, pages: 10 } });
+        }, /pageCache needs a pageSize/);
+        assert.throws(function() {
+            sqlite3.configure({ pageCache: null });
+        }, /pageCache needs a pageSize/);
+        assert.throws(function() {
+            sqlite3.configure({ lookaside: 100 });
+        }, /lookaside needs a non-negative size and count/);
+        assert.throws(function() {
+            new sqlite3.Database(':memory:', { lookaside: { size: -1, count: 10 } });
+        }, /lookaside needs a non-negative size and count/);
+    });
+
+    it('should fail once a database was opened', function(done) {
+        var db = new sqlite3.Database(':memory:', function(err) {
+            if (err) throw err;
+            assert.throws(function() {
+                sqlite3.configure({ memstatus: false });
+            }, /SQLITE_MISUSE: SQLite is already initialized/);
+            db.close(done);
+        });
+    });
+
+    it('should run queries with the pool allocator', function(done) {
+        script(
+            "sqlite3.configure({ allocator: 'pool', memstatus: false," +
+            "    pageCache: { pageSize: 1024, pages: 100 }, lookaside: { size: 128, count: 100 } });" +
+            "var db = new sqlite3.Database(':memory:', { lookaside: { size: 64, count: 50 } });" +
+            "db.serialize(function() {" +
+            "    db.run('CREATE TABLE foo (id INT, txt TEXT)');" +
+            "    var stmt = db.prepare('INSERT INTO foo VALUES(?, ?)');" +
+            "    for (var i = 0; i < 1000; i++) stmt.run(i, new Array(i % 50).join('x'));" +
+            "    stmt.finalize();" +
+            "    db.get('SELECT COUNT(*) AS count FROM foo', function(err, row) {" +
+            "        if (err) throw err;" +
+            "        console.log(row.count);" +
+            "    });" +
+            "});",
+            function(err, stdout) {
+                if (err) throw err;
+                assert.equal(stdout, '1000');
+                done();
+            }
+        );
+    });
+});
@@ -36,3 +36,64 @@ describe('each', function() {
         });
     });
 });
+
+describe('each with buffer limits', function() {
+    var db;
+    before(function(done) {
+        db = new sqlite3.Database('test/support/big.db', sqlite3.OPEN_READONLY, done);
+        db.configure('eachBuffer', { highWaterMark: 100, lowWaterMark: 10, chunkSize: 25 });
+    });
+
+    it('retrieve all rows with a slow item callback', function(done) {
+        var total = 10000;
+        var retrieved = 0;
+
+        db.each('SELECT id, txt FROM foo LIMIT 0, ?', total, function(err, row) {
+            if (err) throw err;
+            // Busy-wait to make the consumer slower than the worker.
+            var until = Date.now() + (retrieved % 1000 === 0 ? 5 : 0);
+            while (Date.now() < until);
+            retrieved++;
+        }, function(err, num) {
+            if (err) throw err;
+            assert.equal(num, total);
+            assert.equal(retrieved, total, "Only retrieved " + retrieved + " out of " + total + " rows.");
+            done();
+        });
+    });
+
+    it('should stall the query at the high-water mark', function(done) {
+        var total = 5000;
+        var retrieved = 0;
+        var stmt = db.prepare('SELECT id, txt FROM foo LIMIT 0, ?');
+
+        stmt.each(total, function(err, row) {
+            if (err) throw err;
+            if (++retrieved !== 1) return;
+
+            // Hold the first row long enough for the worker to fill the
+            // buffer. Nothing was handed back yet, so every stepped row is
+            // still buffered.
+            var until = Date.now() + 100;
+            while (Date.now() < until);
+            var stepped = stmt.status().fullscanStep;
+            assert.ok(stepped <= 100, 'Stepped ' + stepped + ' rows past the high-water mark.');
+            assert.ok(stepped >= 50, 'Only stepped ' + stepped + ' rows.');
+
+            until = Date.now() + 50;
+            while (Date.now() < until);
+            assert.equal(stmt.status().fullscanStep, stepped);
+        }, function(err, num) {
+            if (err) throw err;
+            assert.equal(num, total);
+            assert.equal(retrieved, total);
+            stmt.finalize(done);
+        });
+    });
+
+    it('should reject invalid options', function() {
+        assert.throws(function() {
+            db.configure('eachBuffer', 100);
+        }, /Value must be an object/);
+    });
+});
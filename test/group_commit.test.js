@@ -0,0 +1,140 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+var helper = require('./support/helper');
+
+describe('group commit', function() {
+    var filename = 'test/tmp/test_group_commit.db';
+    var db;
+    before(function(done) {
+        helper.ensureExists('test/tmp');
+        helper.deleteFile(filename);
+        db = new sqlite3.Database(filename, function(err) {
+            if (err) throw err;
+            db.run("CREATE TABLE foo (id INTEGER PRIMARY KEY, txt TEXT)", function(err) {
+                if (err) throw err;
+                db.configure('groupCommit', { maxRows: 10, maxDelayMs: 5 });
+                done();
+            });
+        });
+    });
+
+    it('should fire callbacks after the writes are committed', function(done) {
+        var remaining = 25;
+        var stmt = db.prepare("INSERT INTO foo VALUES(?, ?)");
+        for (var i = 1; i <= 25; i++) {
+            (function(i) {
+                stmt.run(i, 'Row ' + i, function(err) {
+                    if (err) throw err;
+                    assert.equal(this.lastID, i);
+                    if (--remaining) return;
+                    // A separate connection sees all rows.
+                    var other = new sqlite3.Database(filename, sqlite3.OPEN_READONLY);
+                    other.get("SELECT COUNT(*) AS count FROM foo", function(err, row) {
+                        if (err) throw err;
+                        assert.equal(row.count, 25);
+                        other.close(done);
+                    });
+                });
+            })(i);
+        }
+        stmt.finalize();
+    });
+
+    it('should commit before exclusive operations', function(done) {
+        var written = false;
+        db.run("INSERT INTO foo VALUES(100, 'Row 100')", function(err) {
+            if (err) throw err;
+            written = true;
+        });
+        db.exec("SELECT 1", function(err) {
+            if (err) throw err;
+            assert.ok(written);
+            done();
+        });
+    });
+
+    it('should let the application run its own transactions', function(done) {
+        db.serialize(function() {
+            db.run("INSERT INTO foo VALUES(200, 'Row 200')");
+            db.run("BEGIN");
+            db.run("INSERT INTO foo VALUES(201, 'Row 201')");
+            db.run("ROLLBACK");
+            db.all("SELECT id FROM foo WHERE id >= 200", function(err, rows) {
+                if (err) throw err;
+                assert.deepEqual(rows, [ { id: 200 } ]);
+                done();
+            });
+        });
+    });
+
+    it('should commit before writes that do not join the group', function(done) {
+        db.serialize(function() {
+            db.run("INSERT INTO foo VALUES(300, 'Row 300')");
+            var stmt = db.prepare("INSERT INTO foo VALUES(?, ?)");
+            stmt.runBatch([ [ 301, 'Row 301' ], [ 302, 'Row 302' ] ], { transaction: true }, function(err) {
+                if (err) throw err;
+                stmt.finalize();
+
+                // Both the grouped and the batched rows are committed.
+                var other = new sqlite3.Database(filename, sqlite3.OPEN_READONLY);
+                other.get("SELECT COUNT(*) AS count FROM foo WHERE id >= 300", function(err, row) {
+                    if (err) throw err;
+                    assert.equal(row.count, 3);
+                    other.close(done);
+                });
+            });
+        });
+    });
+
+    it('should run writes with a timeout outside the group', function(done) {
+        db.run("INSERT INTO foo VALUES(400, 'Row 400')", { timeoutMs: 1000 }, function(err) {
+            if (err) throw err;
+            var other = new sqlite3.Database(filename, sqlite3.OPEN_READONLY);
+            other.get("SELECT COUNT(*) AS count FROM foo WHERE id = 400", function(err, row) {
+                if (err) throw err;
+                assert.equal(row.count, 1);
+                other.close(done);
+            });
+        });
+    });
+
+    it('should commit before opening a writable blob', function(done) {
+        var blob;
+        db.serialize(function() {
+            db.run("INSERT INTO foo VALUES(500, 'Row 500')", function(err) {
+                if (err) throw err;
+            });
+            blob = new sqlite3.Blob(db, 'foo', 'txt', 500, true, opened);
+        });
+        function opened(err) {
+            if (err) throw err;
+            // Writes while the blob is open don't start an implicit transaction.
+            db.run("INSERT INTO foo VALUES(501, 'Row 501')", function(err) {
+                if (err) throw err;
+                blob.write(0, new Buffer('B'), function(err) {
+                    if (err) throw err;
+                    blob.close(function(err) {
+                        if (err) throw err;
+                        db.get("SELECT txt FROM foo WHERE id = 500", function(err, row) {
+                            if (err) throw err;
+                            assert.equal(row.txt, 'Bow 500');
+                            done();
+                        });
+                    });
+                });
+            });
+        }
+    });
+
+    it('should report constraint errors right away', function(done) {
+        db.run("INSERT INTO foo VALUES(1, 'Duplicate')", function(err) {
+            assert.ok(err);
+            assert.equal(err.code, 'SQLITE_CONSTRAINT');
+            done();
+        });
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
@@ -0,0 +1,101 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+
+describe('interrupt', function() {
+    // Steps through 100 million row combinations.
+    var slow = 'SELECT count(*) AS count FROM foo a, foo b';
+
+    var db;
+    before(function(done) {
+        db = new sqlite3.Database('test/support/big.db', sqlite3.OPEN_READONLY, done);
+    });
+
+    it('should interrupt a running query', function(done) {
+        var start = Date.now();
+        db.get(slow, function(err) {
+            assert.ok(err);
+            assert.equal(err.errno, sqlite3.INTERRUPT);
+            assert.equal(err.code, 'SQLITE_INTERRUPT');
+            assert.ok(Date.now() - start < 5000);
+            done();
+        });
+        setTimeout(function() { db.interrupt(); }, 50);
+    });
+
+    it('should refuse sync calls while a query runs', function(done) {
+        db.get(slow, function(err) {
+            assert.equal(err.code, 'SQLITE_INTERRUPT');
+            done();
+        });
+        setTimeout(function() {
+            assert.throws(function() {
+                db.getSync('SELECT 1 AS one');
+            }, /SQLITE_MISUSE: Database is busy/);
+            db.interrupt();
+        }, 50);
+    });
+
+    it('should run queries after an interrupt', function(done) {
+        db.get('SELECT count(*) AS count FROM foo', function(err, row) {
+            if (err) throw err;
+            assert.equal(row.count, 10000);
+            done();
+        });
+    });
+
+    it('should ignore an interrupt when nothing runs', function(done) {
+        db.interrupt();
+        db.get('SELECT 1 AS one', function(err, row) {
+            if (err) throw err;
+            assert.equal(row.one, 1);
+            done();
+        });
+    });
+
+    it('should time out a query with timeoutMs', function(done) {
+        var start = Date.now();
+        db.all(slow, { timeoutMs: 50 }, function(err) {
+            assert.ok(err);
+            assert.equal(err.errno, sqlite3.TIMEOUT);
+            assert.equal(err.code, 'SQLITE_TIMEOUT');
+            assert.ok(Date.now() - start < 5000);
+            done();
+        });
+    });
+
+    it('should take parameters before the options', function(done) {
+        db.get('SELECT ? AS value', 42, { timeoutMs: 1000 }, function(err, row) {
+            if (err) throw err;
+            assert.equal(row.value, 42);
+            done();
+        });
+    });
+
+    it('should take named parameters before the options', function(done) {
+        db.get('SELECT $id AS id', { $id: 7 }, { timeoutMs: 1000 }, function(err, row) {
+            if (err) throw err;
+            assert.equal(row.id, 7);
+            done();
+        });
+    });
+
+    it('should not drop parameters mixed with options', function(done) {
+        db.get('SELECT $id AS id', { $id: 7, timeoutMs: 1000 }, function(err, row) {
+            assert.ok(err);
+            assert.equal(err.code, 'SQLITE_RANGE');
+            done();
+        });
+    });
+
+    it('should time out each', function(done) {
+        db.each(slow, { timeoutMs: 50 }, function(err, row) {
+            assert.ok(err);
+            assert.equal(err.code, 'SQLITE_TIMEOUT');
+            done();
+        }, function() {});
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
@@ -0,0 +1,82 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+var helper = require('./support/helper');
+
+describe('connection options', function() {
+    var filename = 'test/tmp/test_mmap.db';
+    before(function(done) {
+        helper.ensureExists('test/tmp');
+        helper.deleteFile(filename);
+        var db = new sqlite3.Database(filename);
+        db.serialize(function() {
+            db.run("CREATE TABLE foo (id INT, txt TEXT)");
+            db.run("INSERT INTO foo VALUES(1, 'one')");
+        });
+        db.close(done);
+    });
+
+    it('should reject an invalid mmap size', function() {
+        assert.throws(function() {
+            new sqlite3.Database(filename, { mmapSize: -1 });
+        }, /mmapSize must be a non-negative number/);
+    });
+
+    it('should reject an invalid cache size', function() {
+        assert.throws(function() {
+            new sqlite3.Database(filename, { cacheSize: 'big' });
+        }, /cacheSize must be a non-zero integer/);
+    });
+
+    it('should set the mmap and cache size of every connection', function(done) {
+        var db = new sqlite3.Database(filename, { mmapSize: 1048576, cacheSize: -4096, readers: 2 });
+        var remaining = 4;
+        for (var i = 0; i < 4; i++) {
+            db.get("PRAGMA cache_size", function(err, row) {
+                if (err) throw err;
+                assert.equal(row.cache_size, -4096);
+                if (!--remaining) {
+                    db.get("PRAGMA mmap_size", function(err, row) {
+                        if (err) throw err;
+                        assert.equal(row.mmap_size, 1048576);
+                        db.close(done);
+                    });
+                }
+            });
+        }
+    });
+
+    describe('immutable', function() {
+        var db;
+        before(function(done) {
+            db = new sqlite3.Database(filename, { immutable: true, mmapSize: 1048576, readers: 2 }, done);
+        });
+
+        it('should open the database read-only', function() {
+            assert.equal(db.mode & sqlite3.OPEN_READONLY, sqlite3.OPEN_READONLY);
+            assert.equal(db.mode & sqlite3.OPEN_READWRITE, 0);
+        });
+
+        it('should read rows', function(done) {
+            var remaining = 8;
+            for (var i = 0; i < 8; i++) {
+                db.get("SELECT txt FROM foo WHERE id = 1", function(err, row) {
+                    if (err) throw err;
+                    assert.equal(row.txt, 'one');
+                    if (!--remaining) done();
+                });
+            }
+        });
+
+        it('should refuse writes', function(done) {
+            db.run("INSERT INTO foo VALUES(2, 'two')", function(err) {
+                assert.ok(err);
+                assert.equal(err.code, 'SQLITE_READONLY');
+                done();
+            });
+        });
+
+        after(function(done) {
+            db.close(done);
+        });
+    });
+});
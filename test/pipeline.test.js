@@ -0,0 +1,66 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+
+describe('pipeline', function() {
+    var db;
+    before(function(done) {
+        db = new sqlite3.Database(':memory:', function(err) {
+            if (err) throw err;
+            db.configure('pipeline', true);
+            db.run("CREATE TABLE foo (id INTEGER PRIMARY KEY, txt TEXT)", done);
+        });
+    });
+
+    it('should fire callbacks in order with their own results', function(done) {
+        var stmt = db.prepare("INSERT INTO foo VALUES(?, ?)");
+        var order = [];
+        for (var i = 1; i <= 50; i++) {
+            (function(i) {
+                stmt.run(i, 'Row ' + i, function(err) {
+                    if (err) throw err;
+                    assert.equal(this.lastID, i);
+                    assert.equal(this.changes, 1);
+                    order.push(i);
+                });
+            })(i);
+        }
+        stmt.finalize(function() {
+            assert.equal(order.length, 50);
+            for (var i = 0; i < 50; i++) assert.equal(order[i], i + 1);
+            done();
+        });
+    });
+
+    it('should report errors of single calls', function(done) {
+        var stmt = db.prepare("INSERT INTO foo VALUES(?, ?)");
+        var results = [];
+        stmt.run(100, 'a', function(err) { results.push(err ? err.code : null); });
+        stmt.run(100, 'b', function(err) { results.push(err ? err.code : null); });
+        stmt.run(101, 'c', function(err) { results.push(err ? err.code : null); });
+        stmt.finalize(function() {
+            assert.deepEqual(results, [ null, 'SQLITE_CONSTRAINT', null ]);
+            done();
+        });
+    });
+
+    it('should mix bind, get and reset', function(done) {
+        var stmt = db.prepare("SELECT txt FROM foo WHERE id = ?");
+        var rows = [];
+        stmt.bind(1);
+        stmt.get(function(err, row) { if (err) throw err; rows.push(row); });
+        stmt.reset();
+        stmt.get(function(err, row) { if (err) throw err; rows.push(row); });
+        stmt.get(2, function(err, row) { if (err) throw err; rows.push(row); });
+        stmt.get(9999, function(err, row) { if (err) throw err; rows.push(row); });
+        stmt.finalize(function() {
+            assert.deepEqual(rows, [
+                { txt: 'Row 1' }, { txt: 'Row 1' }, { txt: 'Row 2' }, undefined
+            ]);
+            done();
+        });
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
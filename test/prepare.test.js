@@ -373,4 +373,26 @@ describe('prepare', function() {
 
         after(function(done) { db.close(done); });
     });
+
+    describe('calls without a callback', function() {
+        var db;
+        before(function(done) { db = new sqlite3.Database(':memory:', done); });
+
+        it('should keep the column names for later calls', function(done) {
+            var stmt = db.prepare("SELECT ? AS value");
+            stmt.get(1);
+            stmt.all(2);
+            stmt.get(3, function(err, row) {
+                if (err) throw err;
+                assert.deepEqual(row, { value: 3 });
+                stmt.all(4, function(err, rows) {
+                    if (err) throw err;
+                    assert.deepEqual(rows, [ { value: 4 } ]);
+                    stmt.finalize(done);
+                });
+            });
+        });
+
+        after(function(done) { db.close(done); });
+    });
 });
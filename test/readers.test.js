@@ -0,0 +1,125 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+var helper = require('./support/helper');
+
+describe('readers', function() {
+    var filename = 'test/tmp/test_readers.db';
+    var db;
+    before(function(done) {
+        helper.ensureExists('test/tmp');
+        helper.deleteFile(filename);
+        helper.deleteFile(filename + '-wal');
+        helper.deleteFile(filename + '-shm');
+        db = new sqlite3.Database(filename, { readers: 4 }, done);
+    });
+
+    it('should reject an invalid reader count', function() {
+        assert.throws(function() {
+            new sqlite3.Database(filename, { readers: -1 });
+        }, /readers must be a non-negative integer/);
+    });
+
+    it('should create and fill a table', function(done) {
+        db.serialize(function() {
+            db.run("CREATE TABLE foo (id INT, txt TEXT)");
+            var stmt = db.prepare("INSERT INTO foo VALUES(?, ?)");
+            for (var i = 0; i < 1000; i++) {
+                stmt.run(i, 'Row ' + i);
+            }
+            stmt.finalize(done);
+        });
+    });
+
+    it('should see committed rows from parallel queries', function(done) {
+        var remaining = 16;
+        for (var i = 0; i < 16; i++) {
+            db.get("SELECT COUNT(*) AS count FROM foo", function(err, row) {
+                if (err) throw err;
+                assert.equal(row.count, 1000);
+                if (!--remaining) done();
+            });
+        }
+    });
+
+    it('should see uncommitted rows inside a transaction', function(done) {
+        db.serialize(function() {
+            db.run("BEGIN");
+            db.run("INSERT INTO foo VALUES(1000, 'Row 1000')");
+            db.get("SELECT COUNT(*) AS count FROM foo", function(err, row) {
+                if (err) throw err;
+                assert.equal(row.count, 1001);
+            });
+            db.run("ROLLBACK", done);
+        });
+    });
+
+    it('should move prepared queries into a transaction and back', function(done) {
+        var stmt = db.prepare("SELECT COUNT(*) AS count FROM foo WHERE id >= ?");
+        stmt.get(0, function(err, row) {
+            if (err) throw err;
+            assert.equal(row.count, 1000);
+            db.exec("BEGIN; INSERT INTO foo VALUES(1000, 'Row 1000')", function(err) {
+                if (err) throw err;
+                stmt.get(0, function(err, row) {
+                    if (err) throw err;
+                    assert.equal(row.count, 1001);
+                    db.exec("ROLLBACK", function(err) {
+                        if (err) throw err;
+                        stmt.all(0, function(err, rows) {
+                            if (err) throw err;
+                            assert.deepEqual(rows, [ { count: 1000 } ]);
+                            stmt.finalize(done);
+                        });
+                    });
+                });
+            });
+        });
+    });
+
+    it('should count status over all connections', function(done) {
+        var stmt = db.prepare("SELECT * FROM foo ORDER BY txt");
+        stmt.all(function(err) {
+            if (err) throw err;
+            db.exec("BEGIN", function(err) {
+                if (err) throw err;
+                stmt.all(function(err) {
+                    if (err) throw err;
+                    db.exec("ROLLBACK", function(err) {
+                        if (err) throw err;
+                        // One sort on a reader and one on the primary.
+                        assert.equal(stmt.status(true).sort, 2);
+                        assert.equal(stmt.status().sort, 0);
+                        stmt.finalize(done);
+                    });
+                });
+            });
+        });
+    });
+
+    it('should run pragmas on the primary connection', function(done) {
+        db.serialize(function() {
+            db.get("PRAGMA cache_size = 1000");
+            db.get("PRAGMA cache_size", function(err, row) {
+                if (err) throw err;
+                assert.equal(row.cache_size, 1000);
+                done();
+            });
+        });
+    });
+
+    it('should query temporary tables', function(done) {
+        db.serialize(function() {
+            db.run("CREATE TEMP TABLE bar (id INT)");
+            db.run("INSERT INTO bar VALUES(1)");
+            db.get("SELECT id FROM bar", function(err, row) {
+                if (err) throw err;
+                assert.equal(row.id, 1);
+                done();
+            });
+        });
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
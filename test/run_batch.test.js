@@ -0,0 +1,61 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+
+describe('Statement#runBatch', function() {
+    var db;
+    before(function(done) {
+        db = new sqlite3.Database(':memory:');
+        db.run("CREATE TABLE foo (id INT PRIMARY KEY, txt TEXT)", done);
+    });
+
+    it('should insert all parameter sets', function(done) {
+        var sets = [];
+        for (var i = 0; i < 1000; i++) {
+            sets.push([i, 'Row ' + i]);
+        }
+
+        var stmt = db.prepare("INSERT INTO foo VALUES (?, ?)");
+        stmt.runBatch(sets, { transaction: true }, function(err, results) {
+            if (err) throw err;
+            assert.equal(results.length, 1000);
+            assert.equal(results[999].changes, 1);
+            assert.equal(results[999].lastID, this.lastID);
+            assert.equal(this.changes, 1000);
+            stmt.finalize();
+
+            db.get("SELECT COUNT(*) AS count FROM foo", function(err, row) {
+                if (err) throw err;
+                assert.equal(row.count, 1000);
+                done();
+            });
+        });
+    });
+
+    it('should return an aggregate count', function(done) {
+        var stmt = db.prepare("UPDATE foo SET txt = $txt WHERE id < $id");
+        stmt.runBatch([ { $txt: 'a', $id: 10 }, { $txt: 'b', $id: 20 } ], { aggregate: true }, function(err, changes) {
+            if (err) throw err;
+            assert.equal(changes, 30);
+            stmt.finalize(done);
+        });
+    });
+
+    it('should roll back the batch on error', function(done) {
+        var stmt = db.prepare("INSERT INTO foo VALUES (?, ?)");
+        stmt.runBatch([ [2000, 'new'], [0, 'duplicate'] ], { transaction: true }, function(err) {
+            assert.ok(err);
+            assert.equal(err.code, 'SQLITE_CONSTRAINT');
+            stmt.finalize();
+
+            db.get("SELECT COUNT(*) AS count FROM foo WHERE id = 2000", function(err, row) {
+                if (err) throw err;
+                assert.equal(row.count, 0);
+                done();
+            });
+        });
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
@@ -0,0 +1,107 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+
+describe('Statement#runColumns', function() {
+    var db;
+    before(function(done) {
+        db = new sqlite3.Database(':memory:');
+        db.run("CREATE TABLE foo (id INT PRIMARY KEY, ts REAL, small INT, txt TEXT)", done);
+    });
+
+    it('should insert one row per element of named columns', function(done) {
+        var count = 1000;
+        var ids = new Int32Array(count);
+        var timestamps = new Float64Array(count);
+        var small = new Uint8Array(count);
+        var texts = [];
+        for (var i = 0; i < count; i++) {
+            ids[i] = i;
+            timestamps[i] = i + 0.5;
+            small[i] = i % 256;
+            texts.push('Row ' + i);
+        }
+
+        var stmt = db.prepare("INSERT INTO foo VALUES ($id, $ts, $small, $txt)");
+        stmt.runColumns({ $id: ids, $ts: timestamps, $small: small, $txt: texts }, function(err, changes) {
+            if (err) throw err;
+            assert.equal(changes, 1000);
+            assert.equal(this.changes, 1000);
+            stmt.finalize();
+
+            db.all("SELECT * FROM foo ORDER BY id", function(err, rows) {
+                if (err) throw err;
+                assert.equal(rows.length, 1000);
+                assert.deepEqual(rows[300], { id: 300, ts: 300.5, small: 44, txt: 'Row 300' });
+                done();
+            });
+        });
+    });
+
+    it('should bind an array of columns by position', function(done) {
+        var stmt = db.prepare("UPDATE foo SET txt = ? WHERE id = ?");
+        stmt.runColumns([ [ 'a', 'b', null ], new Int16Array([ 1, 2, 3 ]) ], function(err, changes) {
+            if (err) throw err;
+            assert.equal(changes, 3);
+            stmt.finalize();
+
+            db.all("SELECT txt FROM foo WHERE id BETWEEN 1 AND 3 ORDER BY id", function(err, rows) {
+                if (err) throw err;
+                assert.deepEqual(rows, [ { txt: 'a' }, { txt: 'b' }, { txt: null } ]);
+                done();
+            });
+        });
+    });
+
+    it('should reject columns of different lengths', function() {
+        var stmt = db.prepare("INSERT INTO foo VALUES (?, ?, ?, ?)");
+        assert.throws(function() {
+            stmt.runColumns([ new Int32Array(2), new Float64Array(3) ]);
+        }, /Columns must have the same length/);
+        assert.throws(function() {
+            stmt.runColumns([ 'abc' ]);
+        }, /Columns must be typed arrays or arrays/);
+        stmt.finalize();
+    });
+
+    it('should roll back all rows when one fails', function(done) {
+        var stmt = db.prepare("INSERT INTO foo (id) VALUES (?)");
+        stmt.runColumns([ new Float64Array([ 2000, 2001, 1 ]) ], function(err) {
+            assert.ok(err);
+            assert.equal(err.code, 'SQLITE_CONSTRAINT');
+            stmt.finalize();
+
+            db.get("SELECT COUNT(*) AS count FROM foo WHERE id >= 2000", function(err, row) {
+                if (err) throw err;
+                assert.equal(row.count, 0);
+                done();
+            });
+        });
+    });
+
+    it('should time out with timeoutMs', function(done) {
+        var ids = new Int32Array(10000);
+        for (var i = 0; i < ids.length; i++) ids[i] = i;
+
+        db.run("CREATE TABLE bar (id INT)");
+        var fill = db.prepare("INSERT INTO bar VALUES (?)");
+        fill.runColumns([ ids ], function(err) {
+            if (err) throw err;
+            fill.finalize();
+
+            // Steps through 100 million row combinations.
+            var stmt = db.prepare("INSERT INTO foo (id) SELECT count(*) + ? FROM bar a, bar b");
+            var start = Date.now();
+            stmt.runColumns([ new Int32Array([ 5000 ]) ], { timeoutMs: 50 }, function(err) {
+                assert.ok(err);
+                assert.equal(err.errno, sqlite3.TIMEOUT);
+                assert.equal(err.code, 'SQLITE_TIMEOUT');
+                assert.ok(Date.now() - start < 5000);
+                stmt.finalize(done);
+            });
+        });
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
@@ -0,0 +1,76 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+
+describe('statement cache', function() {
+    var db;
+    before(function(done) {
+        db = new sqlite3.Database(':memory:', done);
+    });
+
+    it('should be disabled by default', function() {
+        var stats = db.statementCacheStats();
+        assert.equal(stats.capacity, 0);
+        assert.equal(stats.size, 0);
+    });
+
+    it('should reject invalid sizes', function() {
+        assert.throws(function() {
+            db.configure('statementCache', -1);
+        }, /Value must be a non-negative integer/);
+    });
+
+    it('should reuse statements of the convenience methods', function(done) {
+        db.configure('statementCache', 2);
+        db.serialize(function() {
+            db.run("CREATE TABLE foo (id INT, txt TEXT)");
+            for (var i = 0; i < 10; i++) {
+                db.run("INSERT INTO foo VALUES(?, ?)", i, 'Row ' + i);
+            }
+            db.get("SELECT COUNT(*) AS count FROM foo", function(err, row) {
+                if (err) throw err;
+                assert.equal(row.count, 10);
+                var stats = db.statementCacheStats();
+                assert.equal(stats.hits, 9);
+                assert.equal(stats.size, 2);
+                done();
+            });
+        });
+    });
+
+    it('should not keep bindings', function(done) {
+        db.all("SELECT ? AS value", 1, function(err, rows) {
+            if (err) throw err;
+            assert.equal(rows[0].value, 1);
+            db.all("SELECT ? AS value", function(err, rows) {
+                if (err) throw err;
+                assert.equal(rows[0].value, null);
+                done();
+            });
+        });
+    });
+
+    it('should pick up schema changes', function(done) {
+        db.serialize(function() {
+            db.all("SELECT * FROM foo LIMIT 1");
+            db.run("ALTER TABLE foo ADD COLUMN extra TEXT");
+            db.all("SELECT * FROM foo LIMIT 1", function(err, rows) {
+                if (err) throw err;
+                assert.deepEqual(Object.keys(rows[0]), [ 'id', 'txt', 'extra' ]);
+                done();
+            });
+        });
+    });
+
+    it('should evict statements when shrunk', function() {
+        db.configure('statementCache', 0);
+        assert.equal(db.statementCacheStats().size, 0);
+    });
+
+    it('should close with cached statements', function(done) {
+        db.configure('statementCache', 10);
+        db.get("SELECT 1", function(err) {
+            if (err) throw err;
+            db.close(done);
+        });
+    });
+});
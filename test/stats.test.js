@@ -0,0 +1,84 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+
+describe('stats', function() {
+    var db;
+    before(function(done) {
+        db = new sqlite3.Database(':memory:');
+        db.configure('stats', true);
+        db.run("CREATE TABLE foo (id int, txt text)", done);
+    });
+
+    it('should be empty before any statement ran', function() {
+        var other = new sqlite3.Database(':memory:');
+        assert.deepEqual(other.stats(), {});
+        other.close();
+    });
+
+    it('should aggregate statements that differ in their literals', function(done) {
+        var remaining = 100;
+        for (var i = 0; i < 100; i++) {
+            db.run("INSERT INTO foo VALUES(" + i + ", 'row " + i + "')", function(err) {
+                if (err) throw err;
+                if (!--remaining) done();
+            });
+        }
+    });
+
+    it('should report counts and percentiles', function() {
+        var stats = db.stats();
+        var insert = stats["INSERT INTO foo VALUES(?, ?)"];
+        assert.ok(insert);
+        assert.equal(insert.count, 100);
+        assert.ok(insert.p50 <= insert.p95);
+        assert.ok(insert.p95 <= insert.p99);
+        assert.ok(insert.p99 <= insert.max);
+        assert.ok(insert.mean <= insert.max);
+        assert.equal(stats["CREATE TABLE foo (id int, txt text)"].count, 1);
+    });
+
+    it('should count parameterized statements under their text', function(done) {
+        var stmt = db.prepare("SELECT * FROM foo WHERE id = ?");
+        for (var i = 0; i < 10; i++) stmt.get(i);
+        stmt.finalize(function(err) {
+            if (err) throw err;
+            assert.equal(db.stats()["SELECT * FROM foo WHERE id = ?"].count, 10);
+            done();
+        });
+    });
+
+    it('should work together with the profile event', function(done) {
+        var profiled = false;
+        db.on('profile', function(sql) {
+            if (sql === "SELECT count(*) FROM foo") profiled = true;
+        });
+        db.get("SELECT count(*) FROM foo", function(err) {
+            if (err) throw err;
+            assert.equal(db.stats()["SELECT count(*) FROM foo"].count, 1);
+            db.removeAllListeners('profile');
+            setTimeout(function() {
+                assert.ok(profiled);
+                done();
+            }, 10);
+        });
+    });
+
+    it('should clear the histograms when reset', function() {
+        var stats = db.stats(true);
+        assert.ok(Object.keys(stats).length > 0);
+        assert.deepEqual(db.stats(), {});
+    });
+
+    it('should stop recording when disabled', function(done) {
+        db.configure('stats', false);
+        db.run("DELETE FROM foo", function(err) {
+            if (err) throw err;
+            assert.deepEqual(db.stats(), {});
+            done();
+        });
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
@@ -0,0 +1,98 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+
+describe('status', function() {
+    var db;
+    before(function(done) {
+        db = new sqlite3.Database(':memory:');
+        db.serialize(function() {
+            db.run("CREATE TABLE foo (id INT, txt TEXT)");
+            db.run("CREATE TABLE bar (id INT)");
+            var stmt = db.prepare("INSERT INTO foo VALUES(?, ?)");
+            for (var i = 0; i < 100; i++) stmt.run(i, 'row ' + i);
+            stmt.finalize();
+            db.run("INSERT INTO bar SELECT id FROM foo", done);
+        });
+    });
+
+    it('should count full table scan steps', function(done) {
+        var stmt = db.prepare("SELECT * FROM foo WHERE txt = ?");
+        stmt.all('row 5', function(err, rows) {
+            if (err) throw err;
+            assert.equal(rows.length, 1);
+            var status = stmt.status();
+            assert.ok(status.fullscanStep >= 99);
+            assert.equal(status.sort, 0);
+            assert.equal(status.autoindex, 0);
+            stmt.finalize(done);
+        });
+    });
+
+    it('should count sorts', function(done) {
+        var stmt = db.prepare("SELECT * FROM foo ORDER BY txt");
+        stmt.all(function(err) {
+            if (err) throw err;
+            assert.equal(stmt.status().sort, 1);
+            stmt.finalize(done);
+        });
+    });
+
+    it('should count automatic indexes', function(done) {
+        var stmt = db.prepare("SELECT * FROM foo, bar WHERE foo.id = bar.id");
+        stmt.all(function(err, rows) {
+            if (err) throw err;
+            assert.equal(rows.length, 100);
+            assert.ok(stmt.status().autoindex > 0);
+            stmt.finalize(done);
+        });
+    });
+
+    it('should reset the statement counters', function(done) {
+        var stmt = db.prepare("SELECT * FROM foo ORDER BY txt");
+        stmt.all(function(err) {
+            if (err) throw err;
+            assert.equal(stmt.status(true).sort, 1);
+            assert.equal(stmt.status().sort, 0);
+            stmt.finalize(function(err) {
+                if (err) throw err;
+                assert.throws(function() {
+                    stmt.status();
+                }, /Statement is already finalized/);
+                done();
+            });
+        });
+    });
+
+    it('should report the connection counters', function(done) {
+        db.status(function(err, status) {
+            if (err) throw err;
+            assert.ok(status.cacheUsed > 0);
+            assert.ok(status.schemaUsed > 0);
+            assert.ok(status.cacheHit > 0);
+            assert.ok('cacheMiss' in status);
+            assert.ok('cacheWrite' in status);
+            assert.ok('stmtUsed' in status);
+            assert.ok(status.lookasideHighwater >= status.lookasideUsed);
+            assert.ok('lookasideHit' in status);
+            assert.ok('lookasideMissSize' in status);
+            assert.ok('lookasideMissFull' in status);
+            done();
+        });
+    });
+
+    it('should reset the connection counters', function(done) {
+        db.status(true, function(err, status) {
+            if (err) throw err;
+            assert.ok(status.cacheHit > 0);
+            db.status(function(err, status) {
+                if (err) throw err;
+                assert.equal(status.cacheHit, 0);
+                done();
+            });
+        });
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
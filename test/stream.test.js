@@ -0,0 +1,110 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+var Writable = require('stream').Writable;
+
+if (Writable) describe('stream', function() {
+    var db;
+    before(function(done) {
+        db = new sqlite3.Database('test/support/big.db', sqlite3.OPEN_READONLY, done);
+    });
+
+    it('should stream all rows with Database#stream', function(done) {
+        var total = 10000;
+        var retrieved = 0;
+
+        db.stream('SELECT id, txt FROM foo LIMIT 0, ?', total)
+            .on('data', function(row) {
+                assert.ok(row.id);
+                retrieved++;
+            })
+            .on('end', function() {
+                assert.equal(retrieved, total);
+                done();
+            });
+    });
+
+    it('should pause the query for a slow consumer', function(done) {
+        var total = 500;
+        var retrieved = 0;
+        var sink = new Writable({ objectMode: true, highWaterMark: 1 });
+        sink._write = function(row, encoding, callback) {
+            retrieved++;
+            setTimeout(callback, retrieved % 100 ? 0 : 5);
+        };
+        sink.on('finish', function() {
+            assert.equal(retrieved, total);
+            done();
+        });
+
+        var stmt = db.prepare('SELECT id FROM foo LIMIT 0, ?');
+        stmt.stream(total).pipe(sink);
+    });
+
+    it('should not step or deliver rows while paused', function(done) {
+        var total = 1000;
+        var retrieved = 0;
+        var paused = false;
+        var stmt = db.prepare('SELECT id FROM foo LIMIT 0, ?');
+        var stream = stmt.stream(total);
+
+        stream.on('data', function(row) {
+            assert.ok(!paused, 'Row delivered while paused.');
+            if (++retrieved !== 100) return;
+
+            paused = true;
+            stream.pause();
+            // A fetch that was already running may still fill the buffer.
+            setTimeout(function() {
+                var stepped = stmt.status().fullscanStep;
+                setTimeout(function() {
+                    assert.equal(stmt.status().fullscanStep, stepped);
+                    assert.equal(retrieved, 100);
+                    paused = false;
+                    stream.resume();
+                }, 50);
+            }, 20);
+        });
+        stream.on('end', function() {
+            assert.equal(retrieved, total);
+            stmt.finalize(done);
+        });
+    });
+
+    it('should fetch rows in batches', function(done) {
+        var stmt = db.prepare('SELECT id FROM foo LIMIT 0, 5');
+        stmt.fetch(3, function(err, rows, done_) {
+            if (err) throw err;
+            assert.equal(rows.length, 3);
+            assert.equal(done_, false);
+        });
+        stmt.fetch(3, function(err, rows, done_) {
+            if (err) throw err;
+            assert.equal(rows.length, 2);
+            assert.equal(done_, true);
+        });
+        stmt.finalize(done);
+    });
+
+    it('should stop early when closed', function(done) {
+        var retrieved = 0;
+        var stream = db.stream('SELECT id FROM foo');
+        stream.on('data', function(row) {
+            if (++retrieved === 10) stream.close();
+        });
+        stream.on('end', function() {
+            assert.ok(retrieved >= 10);
+            done();
+        });
+    });
+
+    it('should report prepare errors', function(done) {
+        db.stream('SELECT id FROM missing_table').on('error', function(err) {
+            assert.equal(err.code, 'SQLITE_ERROR');
+            done();
+        }).resume();
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
@@ -0,0 +1,79 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+
+describe('sync', function() {
+    var db;
+    before(function(done) {
+        db = new sqlite3.Database(':memory:', function(err) {
+            if (err) throw err;
+            db.run("CREATE TABLE foo (id INTEGER PRIMARY KEY, txt TEXT)", done);
+        });
+    });
+
+    it('should run statements on the calling thread', function() {
+        var result = db.runSync("INSERT INTO foo VALUES(?, ?)", 1, 'one');
+        assert.equal(result.lastID, 1);
+        assert.equal(result.changes, 1);
+        db.runSync("INSERT INTO foo VALUES(?, ?)", 2, 'two');
+
+        assert.deepEqual(db.getSync("SELECT txt FROM foo WHERE id = ?", 2), { txt: 'two' });
+        assert.equal(db.getSync("SELECT txt FROM foo WHERE id = ?", 3), undefined);
+        assert.deepEqual(db.allSync("SELECT id FROM foo ORDER BY id"), [ { id: 1 }, { id: 2 } ]);
+    });
+
+    it('should throw SQLite errors', function() {
+        assert.throws(function() {
+            db.runSync("INSERT INTO foo VALUES(?, ?)", 1, 'duplicate');
+        }, /SQLITE_CONSTRAINT/);
+        assert.throws(function() {
+            db.getSync("SELECT * FROM missing");
+        }, /SQLITE_ERROR: no such table: missing/);
+    });
+
+    it('should use prepared statements', function(done) {
+        var stmt = db.prepare("SELECT txt FROM foo WHERE id = ?", function(err) {
+            if (err) throw err;
+            assert.deepEqual(stmt.getSync(1), { txt: 'one' });
+            assert.deepEqual(stmt.allSync(2), [ { txt: 'two' } ]);
+            stmt.finalize(done);
+        });
+    });
+
+    it('should refuse statements that are busy', function(done) {
+        var stmt = db.prepare("SELECT txt FROM foo WHERE id = ?");
+        assert.throws(function() {
+            stmt.getSync(1);
+        }, /SQLITE_MISUSE: Statement is busy/);
+        stmt.get(1, function(err, row) {
+            if (err) throw err;
+            assert.deepEqual(row, { txt: 'one' });
+        });
+        assert.throws(function() {
+            stmt.getSync(1);
+        }, /SQLITE_MISUSE: Statement is busy/);
+        stmt.finalize(function() {
+            assert.throws(function() {
+                stmt.getSync(1);
+            }, /SQLITE_MISUSE: Statement is already finalized/);
+            done();
+        });
+    });
+
+    it('should refuse to overtake serialized calls', function(done) {
+        db.serialize(function() {
+            db.run("INSERT INTO foo VALUES(3, 'three')");
+            assert.throws(function() {
+                db.getSync("SELECT txt FROM foo WHERE id = 3");
+            }, /SQLITE_MISUSE: Database is busy/);
+            db.get("SELECT txt FROM foo WHERE id = 3", function(err, row) {
+                if (err) throw err;
+                assert.deepEqual(row, { txt: 'three' });
+                done();
+            });
+        });
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
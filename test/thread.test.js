@@ -0,0 +1,50 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+
+describe('thread option', function() {
+    it('should reject invalid values', function() {
+        assert.throws(function() {
+            new sqlite3.Database(':memory:', { thread: 1 });
+        }, /thread must be a boolean or a string/);
+    });
+
+    it('should run queries on a dedicated thread', function(done) {
+        var db = new sqlite3.Database(':memory:', { thread: true });
+        db.serialize(function() {
+            db.run("CREATE TABLE foo (id INT)");
+            var stmt = db.prepare("INSERT INTO foo VALUES(?)");
+            for (var i = 0; i < 100; i++) stmt.run(i);
+            stmt.finalize();
+            db.get("SELECT COUNT(*) AS count FROM foo", function(err, row) {
+                if (err) throw err;
+                assert.equal(row.count, 100);
+            });
+            db.close(done);
+        });
+    });
+
+    it('should share a named thread between databases', function(done) {
+        var remaining = 4;
+        for (var i = 0; i < 4; i++) {
+            (function(db, i) {
+                db.get("SELECT ? AS value", i, function(err, row) {
+                    if (err) throw err;
+                    assert.equal(row.value, i);
+                    db.close(function(err) {
+                        if (err) throw err;
+                        if (!--remaining) done();
+                    });
+                });
+            })(new sqlite3.Database(':memory:', { thread: 'shared' }), i);
+        }
+    });
+
+    it('should report errors from the thread', function(done) {
+        var db = new sqlite3.Database(':memory:', { thread: true });
+        db.run("SELECT * FROM missing", function(err) {
+            assert.ok(err);
+            assert.equal(err.code, 'SQLITE_ERROR');
+            db.close(done);
+        });
+    });
+});
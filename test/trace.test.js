@@ -64,4 +64,29 @@ describe('tracing', function() {
         db.run("CREATE TABLE foo (id int)");
         db.close(done);
     });
+
+
+    it('should deliver more statements than fit in the queue in order', function(done) {
+        var db = new sqlite3.Database(':memory:');
+        var count = 5000;
+        var sql = [ 'CREATE TABLE foo (id int)' ];
+        for (var i = 0; i < count; i++) {
+            sql.push('INSERT INTO foo VALUES (' + i + ')');
+        }
+
+        var traced = [];
+        db.on('trace', function(sql) {
+            traced.push(sql);
+        });
+
+        db.exec(sql.join(';\n'));
+        db.close(function(err) {
+            if (err) throw err;
+            assert.equal(traced.length, count + 1);
+            for (var i = 0; i < count; i++) {
+                assert.equal(traced[i + 1], 'INSERT INTO foo VALUES (' + i + ')');
+            }
+            done();
+        });
+    });
 });
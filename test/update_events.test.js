@@ -0,0 +1,112 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+
+describe('change events', function() {
+    var db;
+    before(function(done) {
+        db = new sqlite3.Database(':memory:');
+        db.run('CREATE TABLE foo (id INTEGER PRIMARY KEY, txt TEXT)', done);
+    });
+
+    it('should deliver the inserts of a transaction at once', function(done) {
+        function onInsert(changes) {
+            assert.equal(changes.length, 100);
+            assert.equal(changes[0].database, 'main');
+            assert.equal(changes[0].table, 'foo');
+            assert.equal(changes[0].rowid, 1);
+            assert.equal(changes[99].rowid, 100);
+            db.removeListener('insert', onInsert);
+            done();
+        }
+        db.on('insert', onInsert);
+
+        db.serialize(function() {
+            db.run('BEGIN');
+            var stmt = db.prepare('INSERT INTO foo (txt) VALUES (?)');
+            for (var i = 0; i < 100; i++) stmt.run('row ' + i);
+            stmt.finalize();
+            db.run('COMMIT');
+        });
+    });
+
+    it('should deliver one event per statement in autocommit mode', function(done) {
+        function onUpdate(changes) {
+            assert.equal(changes.length, 100);
+            db.removeListener('update', onUpdate);
+            done();
+        }
+        db.on('update', onUpdate);
+        db.run("UPDATE foo SET txt = 'changed'");
+    });
+
+    it('should not report rolled back changes', function(done) {
+        var deleted = [];
+        function onDelete(changes) {
+            deleted = deleted.concat(changes);
+        }
+        db.on('delete', onDelete);
+
+        db.serialize(function() {
+            db.run('BEGIN');
+            db.run('DELETE FROM foo WHERE id <= 50');
+            db.run('ROLLBACK');
+            db.run('DELETE FROM foo WHERE id = 100', function(err) {
+                if (err) throw err;
+                setTimeout(function() {
+                    assert.equal(deleted.length, 1);
+                    assert.equal(deleted[0].rowid, 100);
+                    db.removeListener('delete', onDelete);
+                    done();
+                }, 50);
+            });
+        });
+    });
+
+    it('should not report rows undone by failed statements', function(done) {
+        function onInsert(changes) {
+            assert.deepEqual(changes.map(function(change) { return change.rowid; }), [ 4000 ]);
+            db.removeListener('insert', onInsert);
+            done();
+        }
+        db.on('insert', onInsert);
+
+        db.serialize(function() {
+            db.run('BEGIN');
+            // The second row conflicts after the first one was inserted.
+            db.run("INSERT INTO foo (id, txt) SELECT 3000, 'a' UNION ALL SELECT 1, 'b'", function(err) {
+                assert.equal(err.code, 'SQLITE_CONSTRAINT');
+            });
+            var stmt = db.prepare('INSERT INTO foo (id) VALUES (?)');
+            stmt.runBatch([ [ 3001 ], [ 3002 ], [ 1 ] ], { transaction: true }, function(err) {
+                assert.equal(err.code, 'SQLITE_CONSTRAINT');
+            });
+            stmt.finalize();
+            db.run('INSERT INTO foo (id) VALUES (4000)');
+            db.run('COMMIT');
+        });
+    });
+
+    it('should only deliver the types that have listeners', function(done) {
+        var updated = false;
+        function onUpdate() { updated = true; }
+        function onInsert(changes) {
+            assert.equal(changes.length, 1);
+            setTimeout(function() {
+                assert.ok(!updated);
+                db.removeListener('insert', onInsert);
+                done();
+            }, 50);
+        }
+        db.on('insert', onInsert);
+        db.on('update', onUpdate);
+        db.removeListener('update', onUpdate);
+        db.serialize(function() {
+            db.run("UPDATE foo SET txt = 'again' WHERE id = 1");
+            db.run("INSERT INTO foo (txt) VALUES ('new')");
+        });
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
@@ -0,0 +1,103 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+
+describe('user functions', function() {
+    var db;
+    before(function(done) {
+        db = new sqlite3.Database(':memory:');
+        db.serialize(function() {
+            db.run('CREATE TABLE points (id INTEGER PRIMARY KEY, x REAL, y REAL, grp TEXT)');
+            var stmt = db.prepare('INSERT INTO points (x, y, grp) VALUES (?, ?, ?)');
+            for (var i = 0; i < 1000; i++) {
+                stmt.run(i % 10, i % 7, i % 2 ? 'odd' : 'even');
+            }
+            stmt.finalize(done);
+        });
+    });
+
+    it('should call a scalar function', function(done) {
+        db.registerFunction('distance', function(x, y) {
+            return Math.sqrt(x * x + y * y);
+        });
+        db.get('SELECT distance(3, 4) AS d', function(err, row) {
+            if (err) throw err;
+            assert.equal(row.d, 5);
+            done();
+        });
+    });
+
+    it('should pass all value types', function(done) {
+        db.registerFunction('describe', function() {
+            return Array.prototype.map.call(arguments, function(value) {
+                if (Buffer.isBuffer(value)) return 'buffer:' + value.length;
+                return value === null ? 'null' : typeof value + ':' + value;
+            }).join(',');
+        });
+        db.get("SELECT describe(1, 2.5, 'text', x'0102', NULL) AS d", function(err, row) {
+            if (err) throw err;
+            assert.equal(row.d, 'number:1,number:2.5,string:text,buffer:2,null');
+            done();
+        });
+    });
+
+    it('should cache results of deterministic functions', function(done) {
+        var calls = 0;
+        db.registerFunction('slow_square', { deterministic: true }, function(x) {
+            calls++;
+            return x * x;
+        });
+        db.all('SELECT slow_square(x) AS s FROM points', function(err, rows) {
+            if (err) throw err;
+            assert.equal(rows.length, 1000);
+            assert.equal(rows[7].s, 49);
+            assert.equal(calls, 10);
+            done();
+        });
+    });
+
+    it('should call aggregates once per group', function(done) {
+        var calls = 0;
+        db.registerFunction('total', { aggregate: true }, function(rows) {
+            calls++;
+            return rows.reduce(function(sum, args) { return sum + args[0]; }, 0);
+        });
+        db.all('SELECT grp, total(x) AS t, sum(x) AS s FROM points GROUP BY grp', function(err, rows) {
+            if (err) throw err;
+            assert.equal(rows.length, 2);
+            rows.forEach(function(row) { assert.equal(row.t, row.s); });
+            assert.equal(calls, 2);
+            done();
+        });
+    });
+
+    it('should report exceptions as errors', function(done) {
+        db.registerFunction('fail', function() {
+            throw new Error('boom');
+        });
+        db.get('SELECT fail() AS f', function(err) {
+            assert.ok(err);
+            assert.equal(err.code, 'SQLITE_ERROR');
+            assert.ok(/boom/.test(err.message));
+            done();
+        });
+    });
+
+    it('should work from the sync methods', function() {
+        var row = db.getSync('SELECT distance(6, 8) AS d');
+        assert.equal(row.d, 10);
+    });
+
+    it('should finalize other statements while a function runs', function(done) {
+        var remaining = 2;
+        function finished(err) {
+            if (err) throw err;
+            if (!--remaining) done();
+        }
+        db.all('SELECT distance(x, y) AS d FROM points', finished);
+        db.get('SELECT count(*) AS count FROM points', finished);
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
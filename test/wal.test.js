@@ -0,0 +1,112 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+var fs = require('fs');
+var helper = require('./support/helper');
+
+describe('journal options', function() {
+    var filename = 'test/tmp/test_journal.db';
+    before(function() {
+        helper.ensureExists('test/tmp');
+        helper.deleteFile(filename);
+    });
+
+    it('should reject an invalid journal mode', function() {
+        assert.throws(function() {
+            new sqlite3.Database(filename, { journalMode: 'fast' });
+        }, /journalMode must be one of/);
+    });
+
+    it('should reject an invalid synchronous level', function() {
+        assert.throws(function() {
+            new sqlite3.Database(filename, { synchronous: 3 });
+        }, /synchronous must be one of/);
+    });
+
+    it('should reject checkpoints without a write-ahead log', function() {
+        assert.throws(function() {
+            new sqlite3.Database(filename, { journalMode: 'delete', checkpoint: true });
+        }, /checkpoint requires the wal journalMode/);
+    });
+
+    it('should set the journal mode and synchronous level', function(done) {
+        var db = new sqlite3.Database(filename, { journalMode: 'TRUNCATE', synchronous: 'off' });
+        db.get("PRAGMA journal_mode", function(err, row) {
+            if (err) throw err;
+            assert.equal(row.journal_mode, 'truncate');
+            db.get("PRAGMA synchronous", function(err, row) {
+                if (err) throw err;
+                assert.equal(row.synchronous, 0);
+                db.close(done);
+            });
+        });
+    });
+});
+
+describe('background checkpoints', function() {
+    var filename = 'test/tmp/test_checkpoint.db';
+    var db;
+    before(function(done) {
+        helper.ensureExists('test/tmp');
+        helper.deleteFile(filename);
+        helper.deleteFile(filename + '-wal');
+        helper.deleteFile(filename + '-shm');
+        db = new sqlite3.Database(filename, { synchronous: 'normal', checkpoint: { pages: 20 } }, done);
+    });
+
+    it('should use a write-ahead log', function(done) {
+        db.get("PRAGMA journal_mode", function(err, row) {
+            if (err) throw err;
+            assert.equal(row.journal_mode, 'wal');
+            assert.equal(db.checkpointStats().pages, 20);
+            done();
+        });
+    });
+
+    it('should checkpoint once the log has grown', function(done) {
+        db.serialize(function() {
+            db.run("CREATE TABLE foo (id INT, txt TEXT)");
+            var stmt = db.prepare("INSERT INTO foo VALUES(?, ?)");
+            for (var i = 0; i < 2000; i++) {
+                stmt.run(i, new Array(200).join('x'));
+            }
+            stmt.finalize(function(err) {
+                if (err) throw err;
+                // The checkpoint runs on a thread of its own.
+                setTimeout(function() {
+                    var stats = db.checkpointStats();
+                    assert.ok(stats.checkpoints > 0);
+                    assert.ok(stats.frames >= 20);
+                    done();
+                }, 200);
+            });
+        });
+    });
+
+    it('should keep the log from growing without bounds', function() {
+        // Without checkpoints, the log would hold every page written.
+        var wal = fs.statSync(filename + '-wal').size;
+        var database = fs.statSync(filename).size;
+        assert.ok(wal < database * 2);
+    });
+
+    it('should close the database', function(done) {
+        db.close(function(err) {
+            if (err) throw err;
+            assert.equal(db.checkpointStats().checkpoints, 0);
+            assert.ok(!fs.existsSync(filename + '-wal'));
+            done();
+        });
+    });
+});
+
+describe('checkpoint option', function() {
+    it('should be ignored for memory databases', function(done) {
+        var db = new sqlite3.Database(':memory:', { checkpoint: true });
+        db.get("PRAGMA journal_mode", function(err, row) {
+            if (err) throw err;
+            assert.equal(row.journal_mode, 'memory');
+            assert.equal(db.checkpointStats().pages, 0);
+            db.close(done);
+        });
+    });
+});